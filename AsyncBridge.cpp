@@ -0,0 +1,131 @@
+/* Copyright 2013-2019 Homegear GmbH
+ *
+ * Homegear is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * Homegear is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with Homegear.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ *
+ * In addition, as a special exception, the copyright holders give
+ * permission to link the code of portions of this program with the
+ * OpenSSL library under certain conditions as described in each
+ * individual source file, and distribute linked combinations
+ * including the two.
+ * You must obey the GNU Lesser General Public License in all respects
+ * for all of the code used other than OpenSSL.  If you modify
+ * file(s) with this exception, you may extend this exception to your
+ * version of the file(s), but you are not obligated to do so.  If you
+ * do not wish to do so, delete this exception statement from your
+ * version.  If you delete this exception statement from all source
+ * files in the program, then also delete it here.
+*/
+
+#include "AsyncBridge.h"
+
+#include <sys/eventfd.h>
+#include <unistd.h>
+
+AsyncBridge::AsyncBridge(IpcClientPool *ipcClientPool, uint32_t workerCount) : _ipcClientPool(ipcClientPool) {
+  _eventFd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+
+  if (workerCount == 0) workerCount = 1;
+  _workers.reserve(workerCount);
+  for (uint32_t i = 0; i < workerCount; i++) {
+    _workers.emplace_back(&AsyncBridge::worker, this);
+  }
+}
+
+AsyncBridge::~AsyncBridge() {
+  {
+    std::lock_guard<std::mutex> jobsGuard(_jobsMutex);
+    _stopWorkers = true;
+  }
+  _jobsConditionVariable.notify_all();
+  for (auto &worker : _workers) {
+    if (worker.joinable()) worker.join();
+  }
+
+  if (_eventFd != -1) close(_eventFd);
+}
+
+void AsyncBridge::invoke(uint64_t id, std::string methodName, Ipc::PArray parameters, std::function<void(const Ipc::PVariable &result)> resultHandler, Metrics::MethodStats *stats) {
+  {
+    std::lock_guard<std::mutex> jobsGuard(_jobsMutex);
+    _jobs.emplace_back();
+    _jobs.back().id = id;
+    _jobs.back().methodName = std::move(methodName);
+    _jobs.back().parameters = std::move(parameters);
+    _jobs.back().resultHandler = std::move(resultHandler);
+    _jobs.back().stats = stats;
+  }
+  _jobsConditionVariable.notify_one();
+}
+
+void AsyncBridge::complete(uint64_t id, Ipc::PVariable result) {
+  {
+    std::lock_guard<std::mutex> resultsGuard(_resultsMutex);
+    _completions.emplace_back();
+    _completions.back().id = id;
+    _completions.back().result = std::move(result);
+  }
+  notify();
+}
+
+void AsyncBridge::pushEvent(Event event) {
+  {
+    std::lock_guard<std::mutex> resultsGuard(_resultsMutex);
+    _events.emplace_back(std::move(event));
+  }
+  notify();
+}
+
+void AsyncBridge::collect(std::vector<Completion> &completions, std::vector<Event> &events) {
+  uint64_t counter = 0;
+  if (read(_eventFd, &counter, sizeof(counter)) == -1) {
+    //EAGAIN, nothing to reset.
+  }
+
+  std::lock_guard<std::mutex> resultsGuard(_resultsMutex);
+  completions.swap(_completions);
+  events.swap(_events);
+}
+
+void AsyncBridge::worker() {
+  while (true) {
+    Job job;
+    {
+      std::unique_lock<std::mutex> jobsLock(_jobsMutex);
+      _jobsConditionVariable.wait(jobsLock, [&] { return _stopWorkers || !_jobs.empty(); });
+      if (_stopWorkers) return;
+      job = std::move(_jobs.front());
+      _jobs.pop_front();
+    }
+
+    Completion completion;
+    completion.id = job.id;
+    if (_ipcClientPool->connected()) completion.result = _ipcClientPool->invoke(job.methodName, job.parameters, job.stats);
+    else completion.result = std::make_shared<Ipc::Variable>();
+    if (job.resultHandler) job.resultHandler(completion.result);
+
+    {
+      std::lock_guard<std::mutex> resultsGuard(_resultsMutex);
+      _completions.emplace_back(std::move(completion));
+    }
+    notify();
+  }
+}
+
+void AsyncBridge::notify() {
+  uint64_t one = 1;
+  if (write(_eventFd, &one, sizeof(one)) == -1) {
+    //The counter can only overflow after 2^64 - 2 unread notifications.
+  }
+}
@@ -0,0 +1,121 @@
+/* Copyright 2013-2019 Homegear GmbH
+ *
+ * Homegear is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * Homegear is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with Homegear.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ *
+ * In addition, as a special exception, the copyright holders give
+ * permission to link the code of portions of this program with the
+ * OpenSSL library under certain conditions as described in each
+ * individual source file, and distribute linked combinations
+ * including the two.
+ * You must obey the GNU Lesser General Public License in all respects
+ * for all of the code used other than OpenSSL.  If you modify
+ * file(s) with this exception, you may extend this exception to your
+ * version of the file(s), but you are not obligated to do so.  If you
+ * do not wish to do so, delete this exception statement from your
+ * version.  If you delete this exception statement from all source
+ * files in the program, then also delete it here.
+*/
+
+#ifndef ASYNCBRIDGE_H_
+#define ASYNCBRIDGE_H_
+
+#include "IpcClientPool.h"
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+/**
+ * Connects IpcClient to an asyncio event loop. RPC calls are executed by a fixed number of worker threads and events are queued. Both signal
+ * an eventfd, which the event loop watches with add_reader(). All Python objects are created by the event loop thread in collect().
+ */
+class AsyncBridge {
+ public:
+  struct Completion {
+    uint64_t id = 0;
+    Ipc::PVariable result;
+  };
+
+  struct Event {
+    uint64_t subscriptionId = 0; //0 for events passed to the event callback and to events()
+    std::string eventSource;
+    uint64_t peerId = 0;
+    int32_t channel = -1;
+    Ipc::PArray variableNames;
+    Ipc::PArray values;
+  };
+
+  AsyncBridge(IpcClientPool *ipcClientPool, uint32_t workerCount);
+  ~AsyncBridge();
+
+  int fileDescriptor() const { return _eventFd; }
+
+  /**
+   * Queues an RPC call. The result is returned by collect() with the passed id.
+   *
+   * @param resultHandler Optional. Called by the worker thread with the result before it is queued.
+   * @param stats Optional. Records the latency of the call.
+   */
+  void invoke(uint64_t id, std::string methodName, Ipc::PArray parameters, std::function<void(const Ipc::PVariable &result)> resultHandler = std::function<void(const Ipc::PVariable &result)>(), Metrics::MethodStats *stats = nullptr);
+
+  /**
+   * Queues a result that was not produced by a worker thread, e. g. for futures waiting for the connection. Can be called from any thread.
+   */
+  void complete(uint64_t id, Ipc::PVariable result);
+
+  /**
+   * Queues an event. Can be called from any thread.
+   */
+  void pushEvent(Event event);
+
+  /**
+   * Moves all finished calls and queued events into the passed vectors and resets the eventfd.
+   */
+  void collect(std::vector<Completion> &completions, std::vector<Event> &events);
+
+  /**
+   * Wakes up the event loop. Used for events queued outside of the bridge.
+   */
+  void notify();
+ private:
+  struct Job {
+    uint64_t id = 0;
+    std::string methodName;
+    Ipc::PArray parameters;
+    std::function<void(const Ipc::PVariable &result)> resultHandler;
+    Metrics::MethodStats *stats = nullptr;
+  };
+
+  IpcClientPool *_ipcClientPool = nullptr;
+  int _eventFd = -1;
+  std::atomic_bool _stopWorkers{false};
+  std::vector<std::thread> _workers;
+
+  std::mutex _jobsMutex;
+  std::condition_variable _jobsConditionVariable;
+  std::deque<Job> _jobs;
+
+  std::mutex _resultsMutex;
+  std::vector<Completion> _completions;
+  std::vector<Event> _events;
+
+  void worker();
+};
+
+#endif
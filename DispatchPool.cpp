@@ -0,0 +1,138 @@
+/* Copyright 2013-2019 Homegear GmbH
+ *
+ * Homegear is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * Homegear is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with Homegear.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ *
+ * In addition, as a special exception, the copyright holders give
+ * permission to link the code of portions of this program with the
+ * OpenSSL library under certain conditions as described in each
+ * individual source file, and distribute linked combinations
+ * including the two.
+ * You must obey the GNU Lesser General Public License in all respects
+ * for all of the code used other than OpenSSL.  If you modify
+ * file(s) with this exception, you may extend this exception to your
+ * version of the file(s), but you are not obligated to do so.  If you
+ * do not wish to do so, delete this exception statement from your
+ * version.  If you delete this exception statement from all source
+ * files in the program, then also delete it here.
+*/
+
+#include "DispatchPool.h"
+
+DispatchPool::DispatchPool(uint32_t workerCount, size_t queueCapacity, EventQueue::OverflowPolicy policy, std::function<void(std::vector<Job> &jobs)> batchHandler)
+    : _queueCapacity(queueCapacity), _policy(policy), _batchHandler(std::move(batchHandler)) {
+  if (workerCount == 0) workerCount = 1;
+  if (_queueCapacity == 0) _queueCapacity = 1;
+  _workers.reserve(workerCount);
+  for (uint32_t i = 0; i < workerCount; i++) {
+    _workers.emplace_back(new Worker());
+  }
+  //The threads are started after all workers exist, as the vector must not change while they run.
+  for (auto &worker : _workers) {
+    worker->thread = std::thread(&DispatchPool::work, this, worker.get());
+  }
+}
+
+DispatchPool::~DispatchPool() {
+  stop();
+}
+
+size_t DispatchPool::size() {
+  size_t size = 0;
+  for (auto &worker : _workers) {
+    std::lock_guard<std::mutex> jobsGuard(worker->mutex);
+    size += worker->jobs.size();
+  }
+  return size;
+}
+
+bool DispatchPool::push(uint64_t shardKey, Job job, uint64_t coalesceKey) {
+  auto &worker = _workers[shardKey % _workers.size()];
+  Job droppedJob; //Destroyed after unlocking
+  {
+    std::unique_lock<std::mutex> jobsLock(worker->mutex);
+    if (_policy == EventQueue::OverflowPolicy::kBlock) {
+      worker->notFullConditionVariable.wait(jobsLock, [&] { return worker->stopped || worker->jobs.size() < _queueCapacity; });
+    }
+    if (worker->stopped) return false;
+
+    if (_policy == EventQueue::OverflowPolicy::kCoalesce && coalesceKey != 0) {
+      auto positionIterator = worker->positions.find(coalesceKey);
+      if (positionIterator != worker->positions.end()) {
+        auto &entry = worker->jobs.at(positionIterator->second - worker->jobs.front().sequence);
+        droppedJob.swap(entry.job);
+        entry.job = std::move(job);
+        _coalescedCount++;
+        return true;
+      }
+    }
+
+    if (worker->jobs.size() >= _queueCapacity) {
+      popFront(worker.get(), droppedJob);
+      _droppedCount++;
+    }
+
+    uint64_t sequence = worker->pushSequence++;
+    if (_policy == EventQueue::OverflowPolicy::kCoalesce && coalesceKey != 0) worker->positions[coalesceKey] = sequence;
+    worker->jobs.push_back(Entry{sequence, _policy == EventQueue::OverflowPolicy::kCoalesce ? coalesceKey : 0, std::move(job)});
+  }
+  worker->notEmptyConditionVariable.notify_one();
+  return true;
+}
+
+void DispatchPool::popFront(Worker *worker, Job &job) {
+  auto &entry = worker->jobs.front();
+  if (entry.coalesceKey != 0) {
+    auto positionIterator = worker->positions.find(entry.coalesceKey);
+    if (positionIterator != worker->positions.end() && positionIterator->second == entry.sequence) worker->positions.erase(positionIterator);
+  }
+  job = std::move(entry.job);
+  worker->jobs.pop_front();
+}
+
+void DispatchPool::stop() {
+  for (auto &worker : _workers) {
+    {
+      std::lock_guard<std::mutex> jobsGuard(worker->mutex);
+      worker->stopped = true;
+      worker->jobs.clear();
+      worker->positions.clear();
+    }
+    worker->notEmptyConditionVariable.notify_all();
+    worker->notFullConditionVariable.notify_all();
+  }
+  for (auto &worker : _workers) {
+    if (worker->thread.joinable()) worker->thread.join();
+  }
+}
+
+void DispatchPool::work(Worker *worker) {
+  std::vector<Job> jobs;
+  jobs.reserve(kMaxBatchSize);
+  while (true) {
+    {
+      std::unique_lock<std::mutex> jobsLock(worker->mutex);
+      worker->notEmptyConditionVariable.wait(jobsLock, [&] { return worker->stopped || !worker->jobs.empty(); });
+      if (worker->stopped) return;
+      while (!worker->jobs.empty() && jobs.size() < kMaxBatchSize) {
+        jobs.emplace_back();
+        popFront(worker, jobs.back());
+      }
+    }
+    worker->notFullConditionVariable.notify_all();
+
+    _batchHandler(jobs);
+    jobs.clear();
+  }
+}
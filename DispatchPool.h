@@ -0,0 +1,116 @@
+/* Copyright 2013-2019 Homegear GmbH
+ *
+ * Homegear is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * Homegear is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with Homegear.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ *
+ * In addition, as a special exception, the copyright holders give
+ * permission to link the code of portions of this program with the
+ * OpenSSL library under certain conditions as described in each
+ * individual source file, and distribute linked combinations
+ * including the two.
+ * You must obey the GNU Lesser General Public License in all respects
+ * for all of the code used other than OpenSSL.  If you modify
+ * file(s) with this exception, you may extend this exception to your
+ * version of the file(s), but you are not obligated to do so.  If you
+ * do not wish to do so, delete this exception statement from your
+ * version.  If you delete this exception statement from all source
+ * files in the program, then also delete it here.
+*/
+
+#ifndef DISPATCHPOOL_H_
+#define DISPATCHPOOL_H_
+
+#include "EventQueue.h"
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+/**
+ * Executes event and node input callbacks on a fixed number of worker threads. Each job has a shard key and all jobs with the same key are executed by
+ * the same worker in the order they were queued, so the events of one device keep their order while different devices are processed in parallel.
+ */
+class DispatchPool {
+ public:
+  typedef std::function<void()> Job;
+
+  static const size_t kMaxBatchSize = 1024;
+
+  /**
+   * @param queueCapacity The maximum number of queued jobs per worker.
+   * @param policy What happens when the queue of a worker is full. With kCoalesce, a queued job is replaced by a new job with the same coalesce key.
+   * @param batchHandler Called by the worker threads with all jobs taken from their queue at once, so the Python thread state only needs to be attached
+   * once per batch.
+   */
+  DispatchPool(uint32_t workerCount, size_t queueCapacity, EventQueue::OverflowPolicy policy, std::function<void(std::vector<Job> &jobs)> batchHandler);
+  ~DispatchPool();
+
+  size_t workerCount() const { return _workers.size(); }
+  size_t capacity() const { return _queueCapacity * _workers.size(); }
+  size_t size();
+  uint64_t droppedCount() const { return _droppedCount; }
+  uint64_t coalescedCount() const { return _coalescedCount; }
+
+  /**
+   * Queues a job on the worker selected by shardKey. When the queue of this worker is full, blocks or drops the oldest job depending on the policy.
+   * Returns false when the pool was stopped.
+   *
+   * @param coalesceKey Only used with kCoalesce. 0 for jobs which must not be replaced.
+   */
+  bool push(uint64_t shardKey, Job job, uint64_t coalesceKey = 0);
+
+  /**
+   * Stops and joins all workers. Jobs still queued are discarded. Must not be called by one of the workers.
+   */
+  void stop();
+ private:
+  struct Entry {
+    uint64_t sequence = 0;
+    uint64_t coalesceKey = 0;
+    Job job;
+  };
+
+  struct Worker {
+    std::mutex mutex;
+    std::condition_variable notEmptyConditionVariable;
+    std::condition_variable notFullConditionVariable;
+    std::deque<Entry> jobs;
+    uint64_t pushSequence = 0;
+    std::unordered_map<uint64_t, uint64_t> positions; //Coalesce key => sequence of the queued job, only used with kCoalesce
+    bool stopped = false;
+    std::thread thread;
+  };
+
+  size_t _queueCapacity = 0;
+  EventQueue::OverflowPolicy _policy = EventQueue::OverflowPolicy::kDropOldest;
+  std::atomic<uint64_t> _droppedCount{0};
+  std::atomic<uint64_t> _coalescedCount{0};
+  std::function<void(std::vector<Job> &jobs)> _batchHandler;
+  std::vector<std::unique_ptr<Worker>> _workers;
+
+  /**
+   * Removes the oldest job of the worker. The worker's mutex must be locked.
+   */
+  void popFront(Worker *worker, Job &job);
+
+  void work(Worker *worker);
+};
+
+#endif
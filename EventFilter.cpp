@@ -0,0 +1,122 @@
+/* Copyright 2013-2019 Homegear GmbH
+ *
+ * Homegear is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * Homegear is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with Homegear.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ *
+ * In addition, as a special exception, the copyright holders give
+ * permission to link the code of portions of this program with the
+ * OpenSSL library under certain conditions as described in each
+ * individual source file, and distribute linked combinations
+ * including the two.
+ * You must obey the GNU Lesser General Public License in all respects
+ * for all of the code used other than OpenSSL.  If you modify
+ * file(s) with this exception, you may extend this exception to your
+ * version of the file(s), but you are not obligated to do so.  If you
+ * do not wish to do so, delete this exception statement from your
+ * version.  If you delete this exception statement from all source
+ * files in the program, then also delete it here.
+*/
+
+#include "EventFilter.h"
+
+void EventFilter::setChannels(int32_t minChannel, int32_t maxChannel) {
+  _filterChannels = true;
+  _minChannel = minChannel;
+  _maxChannel = maxChannel;
+}
+
+void EventFilter::addVariable(const std::string &variable) {
+  if (variable.find_first_of("*?[") == std::string::npos) _variables.emplace(variable);
+  else _variablePatterns.emplace_back(compilePattern(variable));
+}
+
+EventFilter::Pattern EventFilter::compilePattern(const std::string &pattern) {
+  Pattern elements;
+  for (size_t i = 0; i < pattern.size(); i++) {
+    PatternElement element;
+    char c = pattern[i];
+    if (c == '*') {
+      if (!elements.empty() && elements.back().star) continue;
+      element.star = true;
+    } else if (c == '?') element.characters.set();
+    else if (c == '[') {
+      //Bracket expression, "!" or "^" negates it. A "]" directly after the opening bracket is a literal. Without closing bracket, "[" is a literal.
+      size_t j = i + 1;
+      bool negate = j < pattern.size() && (pattern[j] == '!' || pattern[j] == '^');
+      if (negate) j++;
+      size_t start = j;
+      std::bitset<256> characters;
+      for (; j < pattern.size() && (pattern[j] != ']' || j == start); j++) {
+        auto from = (uint8_t)pattern[j];
+        if (pattern[j] == '\\' && j + 1 < pattern.size()) from = (uint8_t)pattern[++j];
+        if (j + 2 < pattern.size() && pattern[j + 1] == '-' && pattern[j + 2] != ']') {
+          auto to = (uint8_t)pattern[j + 2];
+          for (uint32_t k = from; k <= to; k++) {
+            characters.set(k);
+          }
+          j += 2;
+        } else characters.set(from);
+      }
+      if (j < pattern.size()) {
+        element.characters = negate ? ~characters : characters;
+        i = j;
+      } else element.characters.set((uint8_t)c);
+    } else {
+      if (c == '\\' && i + 1 < pattern.size()) c = pattern[++i];
+      element.characters.set((uint8_t)c);
+    }
+    elements.push_back(element);
+  }
+  return elements;
+}
+
+bool EventFilter::matchesPattern(const Pattern &pattern, const std::string &text) {
+  //Greedy matching which backtracks to the last "*" on a mismatch.
+  size_t patternIndex = 0;
+  size_t textIndex = 0;
+  size_t starPatternIndex = std::string::npos;
+  size_t starTextIndex = 0;
+  while (textIndex < text.size()) {
+    if (patternIndex < pattern.size() && !pattern[patternIndex].star && pattern[patternIndex].characters.test((uint8_t)text[textIndex])) {
+      patternIndex++;
+      textIndex++;
+    } else if (patternIndex < pattern.size() && pattern[patternIndex].star) {
+      starPatternIndex = patternIndex++;
+      starTextIndex = textIndex;
+    } else if (starPatternIndex != std::string::npos) {
+      patternIndex = starPatternIndex + 1;
+      textIndex = ++starTextIndex;
+    } else return false;
+  }
+  while (patternIndex < pattern.size() && pattern[patternIndex].star) {
+    patternIndex++;
+  }
+  return patternIndex == pattern.size();
+}
+
+bool EventFilter::matches(const std::string &eventSource, uint64_t peerId, int32_t channel) const {
+  if (!_peerIds.empty() && _peerIds.find(peerId) == _peerIds.end()) return false;
+  if (_filterChannels && (channel < _minChannel || channel > _maxChannel)) return false;
+  if (!_eventSources.empty() && _eventSources.find(eventSource) == _eventSources.end()) return false;
+  return true;
+}
+
+bool EventFilter::matchesVariable(const std::string &variableName) const {
+  if (matchesAllVariables()) return true;
+  if (_variables.find(variableName) != _variables.end()) return true;
+  for (auto &pattern : _variablePatterns) {
+    if (matchesPattern(pattern, variableName)) return true;
+  }
+  return false;
+}
@@ -0,0 +1,88 @@
+/* Copyright 2013-2019 Homegear GmbH
+ *
+ * Homegear is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * Homegear is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with Homegear.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ *
+ * In addition, as a special exception, the copyright holders give
+ * permission to link the code of portions of this program with the
+ * OpenSSL library under certain conditions as described in each
+ * individual source file, and distribute linked combinations
+ * including the two.
+ * You must obey the GNU Lesser General Public License in all respects
+ * for all of the code used other than OpenSSL.  If you modify
+ * file(s) with this exception, you may extend this exception to your
+ * version of the file(s), but you are not obligated to do so.  If you
+ * do not wish to do so, delete this exception statement from your
+ * version.  If you delete this exception statement from all source
+ * files in the program, then also delete it here.
+*/
+
+#ifndef EVENTFILTER_H_
+#define EVENTFILTER_H_
+
+#include <homegear-ipc/IIpcClient.h>
+
+#include <bitset>
+#include <string>
+#include <unordered_set>
+#include <vector>
+
+/**
+ * Matches events of a subscription. Empty criteria match everything.
+ */
+class EventFilter {
+ public:
+  EventFilter() = default;
+  ~EventFilter() = default;
+
+  void addPeerId(uint64_t peerId) { _peerIds.emplace(peerId); }
+  void setChannels(int32_t minChannel, int32_t maxChannel);
+  void addEventSource(const std::string &eventSource) { _eventSources.emplace(eventSource); }
+
+  /**
+   * Adds a variable name. Names containing "*", "?" or "[" are matched as shell-style wildcard patterns like fnmatch() without flags. Patterns are
+   * compiled once here.
+   */
+  void addVariable(const std::string &variable);
+
+  /**
+   * Checks the criteria shared by all variables of one broadcastEvent.
+   */
+  bool matches(const std::string &eventSource, uint64_t peerId, int32_t channel) const;
+
+  bool matchesAllVariables() const { return _variables.empty() && _variablePatterns.empty(); }
+  bool matchesVariable(const std::string &variableName) const;
+ private:
+  /**
+   * One element of a compiled pattern: either "*" or the set of characters matched at this position.
+   */
+  struct PatternElement {
+    bool star = false;
+    std::bitset<256> characters;
+  };
+  typedef std::vector<PatternElement> Pattern;
+
+  static Pattern compilePattern(const std::string &pattern);
+  static bool matchesPattern(const Pattern &pattern, const std::string &text);
+
+  std::unordered_set<uint64_t> _peerIds;
+  bool _filterChannels = false;
+  int32_t _minChannel = 0;
+  int32_t _maxChannel = 0;
+  std::unordered_set<std::string> _eventSources;
+  std::unordered_set<std::string> _variables;
+  std::vector<Pattern> _variablePatterns;
+};
+
+#endif
@@ -0,0 +1,182 @@
+/* Copyright 2013-2019 Homegear GmbH
+ *
+ * Homegear is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * Homegear is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with Homegear.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ *
+ * In addition, as a special exception, the copyright holders give
+ * permission to link the code of portions of this program with the
+ * OpenSSL library under certain conditions as described in each
+ * individual source file, and distribute linked combinations
+ * including the two.
+ * You must obey the GNU Lesser General Public License in all respects
+ * for all of the code used other than OpenSSL.  If you modify
+ * file(s) with this exception, you may extend this exception to your
+ * version of the file(s), but you are not obligated to do so.  If you
+ * do not wish to do so, delete this exception statement from your
+ * version.  If you delete this exception statement from all source
+ * files in the program, then also delete it here.
+*/
+
+#include "EventQueue.h"
+
+#include <sys/eventfd.h>
+#include <unistd.h>
+
+EventQueue::EventQueue(size_t capacity, OverflowPolicy policy) : _policy(policy) {
+  if (capacity == 0) capacity = 1;
+  _buffer.resize(capacity);
+  if (_policy == OverflowPolicy::kCoalesce) _positions.reserve(capacity);
+}
+
+EventQueue::~EventQueue() {
+  if (_eventFd != -1) close(_eventFd);
+}
+
+int EventQueue::enableFileDescriptor() {
+  std::lock_guard<std::mutex> guard(_mutex);
+  if (_eventFd == -1) {
+    _eventFd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    updateFileDescriptor();
+  }
+  return _eventFd;
+}
+
+bool EventQueue::getPolicy(const std::string &name, OverflowPolicy &policy) {
+  if (name == "block") policy = OverflowPolicy::kBlock;
+  else if (name == "dropOldest") policy = OverflowPolicy::kDropOldest;
+  else if (name == "coalesce") policy = OverflowPolicy::kCoalesce;
+  else return false;
+  return true;
+}
+
+size_t EventQueue::size() {
+  std::lock_guard<std::mutex> guard(_mutex);
+  return _writeSequence - _readSequence;
+}
+
+bool EventQueue::push(uint64_t subscriptionId, const std::string &eventSource, uint64_t peerId, int32_t channel, const Ipc::PArray &variableNames, const Ipc::PArray &values) {
+  std::unique_lock<std::mutex> lock(_mutex);
+  for (size_t i = 0; i < variableNames->size() && i < values->size(); i++) {
+    if (_stopped) return false;
+
+    if (_policy == OverflowPolicy::kCoalesce) {
+      Key key;
+      key.subscriptionId = subscriptionId;
+      key.peerId = peerId;
+      key.channel = channel;
+      key.variableName = variableNames->at(i)->stringValue;
+      auto positionIterator = _positions.find(key);
+      if (positionIterator != _positions.end()) {
+        auto &entry = _buffer[positionIterator->second % _buffer.size()];
+        entry.eventSource = eventSource;
+        entry.value = values->at(i);
+        _coalescedCount++;
+        continue;
+      }
+    }
+
+    if (_writeSequence - _readSequence == _buffer.size()) {
+      if (_policy == OverflowPolicy::kBlock) {
+        _notEmptyConditionVariable.notify_one(); //The entries pushed so far must be consumable, otherwise a reader waiting in pop() never frees space.
+        _notFullConditionVariable.wait(lock, [&] { return _stopped || _writeSequence - _readSequence < _buffer.size(); });
+        if (_stopped) return false;
+      } else {
+        dropOldest();
+      }
+    }
+
+    auto &entry = _buffer[_writeSequence % _buffer.size()];
+    entry.subscriptionId = subscriptionId;
+    entry.eventSource = eventSource;
+    entry.peerId = peerId;
+    entry.channel = channel;
+    entry.variableName = variableNames->at(i)->stringValue;
+    entry.value = values->at(i);
+    if (_policy == OverflowPolicy::kCoalesce) {
+      Key key;
+      key.subscriptionId = subscriptionId;
+      key.peerId = peerId;
+      key.channel = channel;
+      key.variableName = entry.variableName;
+      _positions.emplace(std::move(key), _writeSequence);
+    }
+    _writeSequence++;
+    updateFileDescriptor(); //Before blocking on the next variable, so a reader watching the file descriptor is woken up.
+  }
+  lock.unlock();
+  _notEmptyConditionVariable.notify_one();
+  return true;
+}
+
+bool EventQueue::pop(std::vector<Entry> &entries, size_t maxEntries, bool wait) {
+  std::unique_lock<std::mutex> lock(_mutex);
+  if (wait) _notEmptyConditionVariable.wait(lock, [&] { return _stopped || _writeSequence != _readSequence; });
+  if (_stopped) return false;
+
+  bool wasFull = _writeSequence - _readSequence == _buffer.size();
+  while (_readSequence != _writeSequence && entries.size() < maxEntries) {
+    auto &entry = _buffer[_readSequence % _buffer.size()];
+    if (_policy == OverflowPolicy::kCoalesce) {
+      Key key;
+      key.subscriptionId = entry.subscriptionId;
+      key.peerId = entry.peerId;
+      key.channel = entry.channel;
+      key.variableName = entry.variableName;
+      _positions.erase(key);
+    }
+    entries.emplace_back(std::move(entry));
+    entry.value.reset();
+    _readSequence++;
+  }
+  updateFileDescriptor();
+  lock.unlock();
+  if (wasFull) _notFullConditionVariable.notify_all();
+  return true;
+}
+
+void EventQueue::stop() {
+  {
+    std::lock_guard<std::mutex> guard(_mutex);
+    _stopped = true;
+  }
+  _notEmptyConditionVariable.notify_all();
+  _notFullConditionVariable.notify_all();
+}
+
+void EventQueue::dropOldest() {
+  auto &entry = _buffer[_readSequence % _buffer.size()];
+  if (_policy == OverflowPolicy::kCoalesce) {
+    Key key;
+    key.subscriptionId = entry.subscriptionId;
+    key.peerId = entry.peerId;
+    key.channel = entry.channel;
+    key.variableName = entry.variableName;
+    _positions.erase(key);
+  }
+  entry.value.reset();
+  _readSequence++;
+  _droppedCount++;
+}
+
+void EventQueue::updateFileDescriptor() {
+  if (_eventFd == -1) return;
+  bool empty = _writeSequence == _readSequence;
+  if (!empty && !_eventFdReadable) {
+    uint64_t one = 1;
+    if (write(_eventFd, &one, sizeof(one)) != -1) _eventFdReadable = true;
+  } else if (empty && _eventFdReadable) {
+    uint64_t counter = 0;
+    if (read(_eventFd, &counter, sizeof(counter)) != -1) _eventFdReadable = false;
+  }
+}
@@ -0,0 +1,137 @@
+/* Copyright 2013-2019 Homegear GmbH
+ *
+ * Homegear is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * Homegear is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with Homegear.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ *
+ * In addition, as a special exception, the copyright holders give
+ * permission to link the code of portions of this program with the
+ * OpenSSL library under certain conditions as described in each
+ * individual source file, and distribute linked combinations
+ * including the two.
+ * You must obey the GNU Lesser General Public License in all respects
+ * for all of the code used other than OpenSSL.  If you modify
+ * file(s) with this exception, you may extend this exception to your
+ * version of the file(s), but you are not obligated to do so.  If you
+ * do not wish to do so, delete this exception statement from your
+ * version.  If you delete this exception statement from all source
+ * files in the program, then also delete it here.
+*/
+
+#ifndef EVENTQUEUE_H_
+#define EVENTQUEUE_H_
+
+#include <homegear-ipc/IIpcClient.h>
+
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+/**
+ * Bounded ring buffer for events between the IPC thread and the thread calling into Python.
+ */
+class EventQueue {
+ public:
+  enum class OverflowPolicy {
+    kBlock, //The IPC thread waits until there is space. Responses to RPC calls are delayed meanwhile.
+    kDropOldest, //The oldest event is discarded. Default.
+    kCoalesce //Only the latest value per peer, channel and variable is kept. The oldest event is discarded when the queue still is full.
+  };
+
+  struct Entry {
+    uint64_t subscriptionId = 0;
+    std::string eventSource;
+    uint64_t peerId = 0;
+    int32_t channel = -1;
+    std::string variableName;
+    Ipc::PVariable value;
+  };
+
+  EventQueue(size_t capacity, OverflowPolicy policy);
+  ~EventQueue();
+
+  static bool getPolicy(const std::string &name, OverflowPolicy &policy);
+
+  size_t capacity() const { return _buffer.size(); }
+  size_t size();
+  uint64_t droppedCount() const { return _droppedCount; }
+  uint64_t coalescedCount() const { return _coalescedCount; }
+
+  /**
+   * Creates an eventfd, which is readable as long as the queue is not empty, so the queue can be watched with select() or epoll. Returns the file
+   * descriptor or -1 with errno set.
+   */
+  int enableFileDescriptor();
+  int fileDescriptor() const { return _eventFd; }
+
+  /**
+   * Adds all variables of one broadcastEvent RPC. Returns false when the queue was stopped.
+   */
+  bool push(uint64_t subscriptionId, const std::string &eventSource, uint64_t peerId, int32_t channel, const Ipc::PArray &variableNames, const Ipc::PArray &values);
+
+  /**
+   * Moves up to maxEntries events into entries. When wait is true, blocks until there is at least one event or the queue is stopped. Returns false when
+   * the queue was stopped.
+   */
+  bool pop(std::vector<Entry> &entries, size_t maxEntries, bool wait);
+
+  /**
+   * Wakes up all waiting threads. Events pushed after stopping are discarded.
+   */
+  void stop();
+ private:
+  struct Key {
+    uint64_t subscriptionId = 0;
+    uint64_t peerId = 0;
+    int32_t channel = -1;
+    std::string variableName;
+
+    bool operator==(const Key &other) const { return subscriptionId == other.subscriptionId && peerId == other.peerId && channel == other.channel && variableName == other.variableName; }
+  };
+
+  struct KeyHash {
+    size_t operator()(const Key &key) const {
+      size_t hash = std::hash<std::string>()(key.variableName);
+      hash ^= std::hash<uint64_t>()(key.subscriptionId) + 0x9e3779b97f4a7c15ull + (hash << 6) + (hash >> 2);
+      hash ^= std::hash<uint64_t>()(key.peerId) + 0x9e3779b97f4a7c15ull + (hash << 6) + (hash >> 2);
+      hash ^= std::hash<int32_t>()(key.channel) + 0x9e3779b97f4a7c15ull + (hash << 6) + (hash >> 2);
+      return hash;
+    }
+  };
+
+  OverflowPolicy _policy = OverflowPolicy::kDropOldest;
+  bool _stopped = false;
+  std::mutex _mutex;
+  std::condition_variable _notEmptyConditionVariable;
+  std::condition_variable _notFullConditionVariable;
+  std::vector<Entry> _buffer;
+  uint64_t _readSequence = 0; //Sequence number of the oldest event. The slot of a sequence number is sequence % capacity.
+  uint64_t _writeSequence = 0;
+  std::unordered_map<Key, uint64_t, KeyHash> _positions; //Only used with kCoalesce
+  std::atomic<uint64_t> _droppedCount{0};
+  std::atomic<uint64_t> _coalescedCount{0};
+  int _eventFd = -1;
+  bool _eventFdReadable = false;
+
+  void dropOldest();
+
+  /**
+   * Makes the eventfd readable when there are events and resets it when the queue is empty. _mutex must be locked.
+   */
+  void updateFileDescriptor();
+};
+
+#endif
@@ -30,9 +30,13 @@
 
 #include "IpcClient.h"
 
-IpcClient::IpcClient(std::string socketPath) : IIpcClient(socketPath) {
+IpcClient::IpcClient(std::string socketPath, bool callsOnly) : IIpcClient(socketPath), _callsOnly(callsOnly) {
   Ipc::Output::setLogLevel(-1);
 
+  if (_callsOnly) {
+    _localRpcMethods.erase("broadcastEvent");
+    return;
+  }
   _localRpcMethods.emplace("nodeInput", std::bind(&IpcClient::nodeInput, this, std::placeholders::_1));
 }
 
@@ -40,12 +44,84 @@ IpcClient::~IpcClient() {
 }
 
 void IpcClient::onConnect() {
+  //Events might have been missed while the connection was down.
+  if (_valueCache) _valueCache->clear();
   if (_onConnect) _onConnect();
 }
 
+uint64_t IpcClient::addSubscription(std::shared_ptr<EventFilter> filter) {
+  std::lock_guard<std::mutex> subscriptionsGuard(_subscriptionsMutex);
+  auto subscriptions = _subscriptions ? std::make_shared<std::vector<Subscription>>(*_subscriptions) : std::make_shared<std::vector<Subscription>>();
+  Subscription subscription;
+  subscription.id = ++_currentSubscriptionId;
+  subscription.filter = std::move(filter);
+  subscriptions->emplace_back(std::move(subscription));
+  _subscriptions = subscriptions;
+  return _currentSubscriptionId;
+}
+
+bool IpcClient::removeSubscription(uint64_t subscriptionId) {
+  std::lock_guard<std::mutex> subscriptionsGuard(_subscriptionsMutex);
+  if (!_subscriptions) return false;
+  auto subscriptions = std::make_shared<std::vector<Subscription>>();
+  subscriptions->reserve(_subscriptions->size());
+  for (auto &subscription : *_subscriptions) {
+    if (subscription.id != subscriptionId) subscriptions->push_back(subscription);
+  }
+  if (subscriptions->size() == _subscriptions->size()) return false;
+  _subscriptions = subscriptions;
+  return true;
+}
+
 // {{{ RPC methods
 Ipc::PVariable IpcClient::broadcastEvent(Ipc::PArray &parameters) {
+  if (_callsOnly) return std::make_shared<Ipc::Variable>();
   if (parameters->size() != 5) return Ipc::Variable::createError(-1, "Wrong parameter count.");
+  if (parameters->at(3)->arrayValue->size() != parameters->at(4)->arrayValue->size()) return Ipc::Variable::createError(-1, "Variable names and values have different sizes.");
+
+  if (_metrics) _metrics->eventsReceived.add(parameters->at(3)->arrayValue->size());
+  if (_valueCache) _valueCache->update((uint64_t)parameters->at(1)->integerValue64, parameters->at(2)->integerValue, parameters->at(3)->arrayValue, parameters->at(4)->arrayValue);
+
+  if (_subscriptionEvent) {
+    std::shared_ptr<const std::vector<Subscription>> subscriptions;
+    {
+      std::lock_guard<std::mutex> subscriptionsGuard(_subscriptionsMutex);
+      subscriptions = _subscriptions;
+    }
+
+    if (subscriptions) {
+      auto &eventSource = parameters->at(0)->stringValue;
+      auto peerId = (uint64_t)parameters->at(1)->integerValue64;
+      auto channel = parameters->at(2)->integerValue;
+      auto &variableNames = parameters->at(3)->arrayValue;
+      auto &values = parameters->at(4)->arrayValue;
+      for (auto &subscription : *subscriptions) {
+        if (!subscription.filter->matches(eventSource, peerId, channel)) {
+          if (_metrics) _metrics->eventsFiltered.add(variableNames->size());
+          continue;
+        }
+        if (subscription.filter->matchesAllVariables()) {
+          _subscriptionEvent(subscription.id, eventSource, peerId, channel, variableNames, values);
+          continue;
+        }
+
+        auto matchedVariableNames = std::make_shared<Ipc::Array>();
+        auto matchedValues = std::make_shared<Ipc::Array>();
+        for (uint32_t i = 0; i < variableNames->size(); ++i) {
+          if (!subscription.filter->matchesVariable(variableNames->at(i)->stringValue)) continue;
+          matchedVariableNames->push_back(variableNames->at(i));
+          matchedValues->push_back(values->at(i));
+        }
+        if (_metrics) _metrics->eventsFiltered.add(variableNames->size() - matchedVariableNames->size());
+        if (!matchedVariableNames->empty()) _subscriptionEvent(subscription.id, eventSource, peerId, channel, matchedVariableNames, matchedValues);
+      }
+    }
+  }
+
+  if (_broadcastEventBatch) {
+    _broadcastEventBatch(parameters->at(0)->stringValue, (uint64_t)parameters->at(1)->integerValue64, parameters->at(2)->integerValue, parameters->at(3)->arrayValue, parameters->at(4)->arrayValue);
+    return std::make_shared<Ipc::Variable>();
+  }
 
   for (uint32_t i = 0; i < parameters->at(3)->arrayValue->size(); ++i) {
     if (_broadcastEvent) _broadcastEvent(parameters->at(0)->stringValue, (uint64_t)parameters->at(1)->integerValue64, parameters->at(2)->integerValue, parameters->at(3)->arrayValue->at(i)->stringValue, parameters->at(4)->arrayValue->at(i));
@@ -31,8 +31,13 @@
 #ifndef IPCCLIENT_H_
 #define IPCCLIENT_H_
 
+#include "EventFilter.h"
+#include "Metrics.h"
+#include "ValueCache.h"
+
 #include <homegear-ipc/IIpcClient.h>
 
+#include <memory>
 #include <thread>
 #include <mutex>
 #include <string>
@@ -40,18 +45,52 @@
 
 class IpcClient : public Ipc::IIpcClient {
  public:
-  explicit IpcClient(std::string socketPath);
+  /**
+   * @param callsOnly When true, the client is only used for calls, e. g. as additional connection of an IpcClientPool. It doesn't register the event
+   * and node input methods, so events Homegear sends to every IPC client are not processed by it.
+   */
+  explicit IpcClient(std::string socketPath, bool callsOnly = false);
   ~IpcClient() override;
 
   void setOnConnect(std::function<void(void)> value) { _onConnect.swap(value); }
   void removeOnConnect() { _onConnect = std::function<void(void)>(); }
   void setBroadcastEvent(std::function<void(std::string &eventSource, uint64_t peerId, int32_t channel, std::string &variableName, Ipc::PVariable value)> value) { _broadcastEvent.swap(value); }
   void removeBroadcastEvent() { _broadcastEvent = std::function<void(std::string &eventSource, uint64_t peerId, int32_t channel, std::string &variableName, Ipc::PVariable value)>(); }
+  void setBroadcastEventBatch(std::function<void(std::string &eventSource, uint64_t peerId, int32_t channel, Ipc::PArray &variableNames, Ipc::PArray &values)> value) { _broadcastEventBatch.swap(value); }
+  void removeBroadcastEventBatch() { _broadcastEventBatch = std::function<void(std::string &eventSource, uint64_t peerId, int32_t channel, Ipc::PArray &variableNames, Ipc::PArray &values)>(); }
+  void setSubscriptionEvent(std::function<void(uint64_t subscriptionId, std::string &eventSource, uint64_t peerId, int32_t channel, Ipc::PArray &variableNames, Ipc::PArray &values)> value) { _subscriptionEvent.swap(value); }
+  void removeSubscriptionEvent() { _subscriptionEvent = std::function<void(uint64_t subscriptionId, std::string &eventSource, uint64_t peerId, int32_t channel, Ipc::PArray &variableNames, Ipc::PArray &values)>(); }
   void setNodeInput(std::function<void(const Ipc::PVariable &nodeInfo, uint32_t inputIndex, const Ipc::PVariable message)> value) { _nodeInput.swap(value); }
   void removeNodeInput() { _nodeInput = std::function<void(const Ipc::PVariable &nodeInfo, uint32_t inputIndex, const Ipc::PVariable message)>(); }
+
+  /**
+   * Sets the cache updated by broadcastEvent and cleared on connect. Must be called before start() and stay valid until the client is destroyed.
+   */
+  void setValueCache(ValueCache *valueCache) { _valueCache = valueCache; }
+
+  /**
+   * Sets the object counting received and filtered events. Must be called before start() and stay valid until the client is destroyed.
+   */
+  void setMetrics(Metrics *metrics) { _metrics = metrics; }
+
+  uint64_t addSubscription(std::shared_ptr<EventFilter> filter);
+  bool removeSubscription(uint64_t subscriptionId);
  private:
+  struct Subscription {
+    uint64_t id = 0;
+    std::shared_ptr<EventFilter> filter;
+  };
+
+  bool _callsOnly = false;
   std::function<void(void)> _onConnect;
+  ValueCache *_valueCache = nullptr;
+  Metrics *_metrics = nullptr;
   std::function<void(std::string &eventSource, uint64_t peerId, int32_t channel, std::string &variableName, Ipc::PVariable value)> _broadcastEvent;
+  std::function<void(std::string &eventSource, uint64_t peerId, int32_t channel, Ipc::PArray &variableNames, Ipc::PArray &values)> _broadcastEventBatch;
+  std::function<void(uint64_t subscriptionId, std::string &eventSource, uint64_t peerId, int32_t channel, Ipc::PArray &variableNames, Ipc::PArray &values)> _subscriptionEvent;
+  std::mutex _subscriptionsMutex;
+  uint64_t _currentSubscriptionId = 0;
+  std::shared_ptr<const std::vector<Subscription>> _subscriptions; //Replaced on every change, so broadcastEvent() doesn't need to hold the mutex while matching.
   std::function<void(const Ipc::PVariable &nodeInfo, uint32_t inputIndex, const Ipc::PVariable message)> _nodeInput;
 
   void onConnect() override;
@@ -0,0 +1,86 @@
+/* Copyright 2013-2019 Homegear GmbH
+ *
+ * Homegear is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * Homegear is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with Homegear.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ *
+ * In addition, as a special exception, the copyright holders give
+ * permission to link the code of portions of this program with the
+ * OpenSSL library under certain conditions as described in each
+ * individual source file, and distribute linked combinations
+ * including the two.
+ * You must obey the GNU Lesser General Public License in all respects
+ * for all of the code used other than OpenSSL.  If you modify
+ * file(s) with this exception, you may extend this exception to your
+ * version of the file(s), but you are not obligated to do so.  If you
+ * do not wish to do so, delete this exception statement from your
+ * version.  If you delete this exception statement from all source
+ * files in the program, then also delete it here.
+*/
+
+#include "IpcClientPool.h"
+
+IpcClientPool::IpcClientPool(IpcClient *primaryClient, const std::string &socketPath, uint32_t size) {
+  if (size == 0) size = 1;
+  _clients.reserve(size);
+  _clients.push_back(primaryClient);
+  for (uint32_t i = 1; i < size; i++) {
+    _clients.push_back(new IpcClient(socketPath, true));
+  }
+  _outstandingRequests.reset(new std::atomic<uint32_t>[size]);
+  for (uint32_t i = 0; i < size; i++) {
+    _outstandingRequests[i] = 0;
+  }
+}
+
+IpcClientPool::~IpcClientPool() {
+  for (size_t i = 1; i < _clients.size(); i++) {
+    _clients[i]->stop();
+    delete _clients[i];
+  }
+}
+
+void IpcClientPool::start() {
+  for (size_t i = 1; i < _clients.size(); i++) {
+    _clients[i]->start();
+  }
+}
+
+void IpcClientPool::stop() {
+  for (auto &client : _clients) {
+    client->stop();
+  }
+}
+
+Ipc::PVariable IpcClientPool::invoke(const std::string &methodName, const Ipc::PArray &parameters, Metrics::MethodStats *stats) {
+  size_t clientIndex = 0;
+  if (_clients.size() > 1) {
+    uint32_t lowestOutstandingRequests = UINT32_MAX;
+    for (size_t i = 0; i < _clients.size(); i++) {
+      if (!_clients[i]->connected()) continue;
+      uint32_t outstandingRequests = _outstandingRequests[i].load(std::memory_order_relaxed);
+      if (outstandingRequests < lowestOutstandingRequests) {
+        lowestOutstandingRequests = outstandingRequests;
+        clientIndex = i;
+        if (outstandingRequests == 0) break;
+      }
+    }
+  }
+
+  auto startTime = std::chrono::steady_clock::now();
+  _outstandingRequests[clientIndex]++;
+  auto result = _clients[clientIndex]->invoke(methodName, parameters);
+  _outstandingRequests[clientIndex]--;
+  if (stats) stats->record(std::chrono::steady_clock::now() - startTime, !result || result->errorStruct);
+  return result;
+}
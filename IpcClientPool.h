@@ -0,0 +1,78 @@
+/* Copyright 2013-2019 Homegear GmbH
+ *
+ * Homegear is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * Homegear is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with Homegear.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ *
+ * In addition, as a special exception, the copyright holders give
+ * permission to link the code of portions of this program with the
+ * OpenSSL library under certain conditions as described in each
+ * individual source file, and distribute linked combinations
+ * including the two.
+ * You must obey the GNU Lesser General Public License in all respects
+ * for all of the code used other than OpenSSL.  If you modify
+ * file(s) with this exception, you may extend this exception to your
+ * version of the file(s), but you are not obligated to do so.  If you
+ * do not wish to do so, delete this exception statement from your
+ * version.  If you delete this exception statement from all source
+ * files in the program, then also delete it here.
+*/
+
+#ifndef IPCCLIENTPOOL_H_
+#define IPCCLIENTPOOL_H_
+
+#include "IpcClient.h"
+
+#include <atomic>
+#include <memory>
+#include <string>
+#include <vector>
+
+/**
+ * Spreads RPC calls over several connections to Homegear. The primary client is the one events, node input and the value cache are registered on.
+ * The additional clients are only used for calls, so events are not processed twice.
+ */
+class IpcClientPool {
+ public:
+  /**
+   * @param primaryClient Owned by the caller. Must stay valid until the pool is destroyed.
+   * @param size The total number of connections including the primary client.
+   */
+  IpcClientPool(IpcClient *primaryClient, const std::string &socketPath, uint32_t size);
+  ~IpcClientPool();
+
+  size_t size() const { return _clients.size(); }
+  bool connected() { return _clients.front()->connected(); }
+
+  /**
+   * Starts the additional clients. The primary client is started by its owner.
+   */
+  void start();
+
+  /**
+   * Stops all clients including the primary client, so calls still in progress return.
+   */
+  void stop();
+
+  /**
+   * Executes the call on the connected client with the least outstanding requests. Can be called from any thread.
+   *
+   * @param stats When set, the latency of the call and whether it failed are recorded there.
+   */
+  Ipc::PVariable invoke(const std::string &methodName, const Ipc::PArray &parameters, Metrics::MethodStats *stats = nullptr);
+ private:
+  std::vector<IpcClient *> _clients; //The first element is the primary client.
+  std::unique_ptr<std::atomic<uint32_t>[]> _outstandingRequests;
+};
+
+#endif
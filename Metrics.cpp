@@ -0,0 +1,139 @@
+/* Copyright 2013-2019 Homegear GmbH
+ *
+ * Homegear is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * Homegear is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with Homegear.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ *
+ * In addition, as a special exception, the copyright holders give
+ * permission to link the code of portions of this program with the
+ * OpenSSL library under certain conditions as described in each
+ * individual source file, and distribute linked combinations
+ * including the two.
+ * You must obey the GNU Lesser General Public License in all respects
+ * for all of the code used other than OpenSSL.  If you modify
+ * file(s) with this exception, you may extend this exception to your
+ * version of the file(s), but you are not obligated to do so.  If you
+ * do not wish to do so, delete this exception statement from your
+ * version.  If you delete this exception statement from all source
+ * files in the program, then also delete it here.
+*/
+
+#include "Metrics.h"
+
+uint64_t Metrics::Counter::get() const {
+  uint64_t value = 0;
+  for (auto &shard : _shards) {
+    value += shard.value.load(std::memory_order_relaxed);
+  }
+  return value;
+}
+
+void Metrics::Counter::reset() {
+  for (auto &shard : _shards) {
+    shard.value.store(0, std::memory_order_relaxed);
+  }
+}
+
+void Metrics::MethodStats::record(std::chrono::nanoseconds latency, bool error) {
+  auto &shard = _shards[shardIndex()];
+  shard.calls.fetch_add(1, std::memory_order_relaxed);
+  if (error) shard.errors.fetch_add(1, std::memory_order_relaxed);
+  uint64_t nanoseconds = latency.count() > 0 ? (uint64_t)latency.count() : 0;
+  shard.latencySumNanoseconds.fetch_add(nanoseconds, std::memory_order_relaxed);
+
+  uint64_t microseconds = nanoseconds / 1000;
+  size_t bucket = 0;
+  while (bucket < kLatencyBuckets - 1 && microseconds >= (1ull << bucket)) {
+    bucket++;
+  }
+  shard.latencyBuckets[bucket].fetch_add(1, std::memory_order_relaxed);
+}
+
+Metrics::MethodStats::Snapshot Metrics::MethodStats::get() const {
+  Snapshot snapshot;
+  for (auto &shard : _shards) {
+    snapshot.calls += shard.calls.load(std::memory_order_relaxed);
+    snapshot.errors += shard.errors.load(std::memory_order_relaxed);
+    snapshot.latencySumNanoseconds += shard.latencySumNanoseconds.load(std::memory_order_relaxed);
+    for (size_t i = 0; i < kLatencyBuckets; i++) {
+      snapshot.latencyBuckets[i] += shard.latencyBuckets[i].load(std::memory_order_relaxed);
+    }
+  }
+  return snapshot;
+}
+
+void Metrics::MethodStats::reset() {
+  for (auto &shard : _shards) {
+    shard.calls.store(0, std::memory_order_relaxed);
+    shard.errors.store(0, std::memory_order_relaxed);
+    shard.latencySumNanoseconds.store(0, std::memory_order_relaxed);
+    for (auto &bucket : shard.latencyBuckets) {
+      bucket.store(0, std::memory_order_relaxed);
+    }
+  }
+}
+
+Metrics::Metrics() {
+  _startTime = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+size_t Metrics::shardIndex() {
+  static thread_local size_t index = std::hash<std::thread::id>()(std::this_thread::get_id()) % kShards;
+  return index;
+}
+
+Metrics::MethodStats *Metrics::getMethodStats(const std::string &methodName) {
+  std::lock_guard<std::mutex> methodStatsGuard(_methodStatsMutex);
+  if (_methodStats.size() >= kMaxMethodStats && _methodStats.find(methodName) == _methodStats.end()) {
+    auto &otherStats = _methodStats["(other)"];
+    if (!otherStats) otherStats.reset(new MethodStats());
+    return otherStats.get();
+  }
+  auto &methodStats = _methodStats[methodName];
+  if (!methodStats) methodStats.reset(new MethodStats());
+  return methodStats.get();
+}
+
+std::vector<std::pair<std::string, Metrics::MethodStats::Snapshot>> Metrics::getMethodSnapshots() {
+  std::vector<std::pair<std::string, MethodStats::Snapshot>> snapshots;
+  std::lock_guard<std::mutex> methodStatsGuard(_methodStatsMutex);
+  snapshots.reserve(_methodStats.size());
+  for (auto &methodStats : _methodStats) {
+    auto snapshot = methodStats.second->get();
+    if (snapshot.calls > 0) snapshots.emplace_back(methodStats.first, snapshot);
+  }
+  return snapshots;
+}
+
+std::chrono::nanoseconds Metrics::elapsed() const {
+  return std::chrono::steady_clock::now().time_since_epoch() - std::chrono::nanoseconds(_startTime.load());
+}
+
+void Metrics::reset() {
+  {
+    std::lock_guard<std::mutex> methodStatsGuard(_methodStatsMutex);
+    for (auto &methodStats : _methodStats) {
+      methodStats.second->reset();
+    }
+  }
+  eventsReceived.reset();
+  eventsFiltered.reset();
+  eventsDispatched.reset();
+  gilWaits.reset();
+  gilWaitNanoseconds.reset();
+  callbacks.reset();
+  callbackNanoseconds.reset();
+  bytesToHomegear.reset();
+  bytesToPython->reset();
+  _startTime = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
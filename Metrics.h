@@ -0,0 +1,127 @@
+/* Copyright 2013-2019 Homegear GmbH
+ *
+ * Homegear is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * Homegear is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with Homegear.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ *
+ * In addition, as a special exception, the copyright holders give
+ * permission to link the code of portions of this program with the
+ * OpenSSL library under certain conditions as described in each
+ * individual source file, and distribute linked combinations
+ * including the two.
+ * You must obey the GNU Lesser General Public License in all respects
+ * for all of the code used other than OpenSSL.  If you modify
+ * file(s) with this exception, you may extend this exception to your
+ * version of the file(s), but you are not obligated to do so.  If you
+ * do not wish to do so, delete this exception statement from your
+ * version.  If you delete this exception statement from all source
+ * files in the program, then also delete it here.
+*/
+
+#ifndef METRICS_H_
+#define METRICS_H_
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+/**
+ * Counters for calls, events and callbacks. All counters are split into shards, each thread updates the shard selected by its thread ID with relaxed
+ * atomic operations, so recording never takes a lock and threads don't contend on the same cache line. Reading sums up all shards.
+ */
+class Metrics {
+ public:
+  static const size_t kShards = 8;
+  static const size_t kLatencyBuckets = 24; //Bucket i counts latencies below 2^i microseconds, the last bucket also counts all longer latencies.
+  static const size_t kMaxMethodStats = 1024; //Further method names share the entry "(other)"
+
+  class Counter {
+   public:
+    void add(uint64_t value) { _shards[shardIndex()].value.fetch_add(value, std::memory_order_relaxed); }
+    uint64_t get() const;
+    void reset();
+   private:
+    struct alignas(64) Shard {
+      std::atomic<uint64_t> value{0};
+    };
+
+    std::array<Shard, kShards> _shards;
+  };
+
+  class MethodStats {
+   public:
+    struct Snapshot {
+      uint64_t calls = 0;
+      uint64_t errors = 0;
+      uint64_t latencySumNanoseconds = 0;
+      std::array<uint64_t, kLatencyBuckets> latencyBuckets{};
+    };
+
+    void record(std::chrono::nanoseconds latency, bool error);
+    Snapshot get() const;
+    void reset();
+   private:
+    struct alignas(64) Shard {
+      std::atomic<uint64_t> calls{0};
+      std::atomic<uint64_t> errors{0};
+      std::atomic<uint64_t> latencySumNanoseconds{0};
+      std::array<std::atomic<uint64_t>, kLatencyBuckets> latencyBuckets{};
+    };
+
+    std::array<Shard, kShards> _shards;
+  };
+
+  Metrics();
+  ~Metrics() = default;
+
+  static size_t shardIndex();
+
+  /**
+   * Returns the statistics of an RPC method. The returned pointer stays valid as long as this object exists. When kMaxMethodStats methods are tracked
+   * already, the statistics of unknown methods are counted in one shared entry.
+   */
+  MethodStats *getMethodStats(const std::string &methodName);
+  std::vector<std::pair<std::string, MethodStats::Snapshot>> getMethodSnapshots();
+
+  /**
+   * Returns the time since construction or the last reset.
+   */
+  std::chrono::nanoseconds elapsed() const;
+
+  /**
+   * Resets all counters. Concurrent updates might be lost or counted partly.
+   */
+  void reset();
+
+  Counter eventsReceived; //Variables received by broadcastEvent
+  Counter eventsFiltered; //Variables not passed to a subscription because of its filter
+  Counter eventsDispatched; //Calls of event callbacks, stream items and dicts with batchEvents
+  Counter gilWaits;
+  Counter gilWaitNanoseconds; //Time spent in PyGILState_Ensure() by the callback threads
+  Counter callbacks;
+  Counter callbackNanoseconds; //Time spent in event and node input callbacks
+  Counter bytesToHomegear; //String and binary bytes converted from Python objects
+  std::shared_ptr<Counter> bytesToPython = std::make_shared<Counter>(); //Shared with lazy containers, which convert their elements after the call returned
+ private:
+  std::atomic<int64_t> _startTime; //Steady clock nanoseconds
+  std::mutex _methodStatsMutex;
+  std::unordered_map<std::string, std::unique_ptr<MethodStats>> _methodStats;
+};
+
+#endif
@@ -0,0 +1,309 @@
+/* Copyright 2013-2019 Homegear GmbH
+ *
+ * Homegear is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * Homegear is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with Homegear.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ *
+ * In addition, as a special exception, the copyright holders give
+ * permission to link the code of portions of this program with the
+ * OpenSSL library under certain conditions as described in each
+ * individual source file, and distribute linked combinations
+ * including the two.
+ * You must obey the GNU Lesser General Public License in all respects
+ * for all of the code used other than OpenSSL.  If you modify
+ * file(s) with this exception, you may extend this exception to your
+ * version of the file(s), but you are not obligated to do so.  If you
+ * do not wish to do so, delete this exception statement from your
+ * version.  If you delete this exception statement from all source
+ * files in the program, then also delete it here.
+*/
+
+#include "OfflineQueue.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <fstream>
+#include <iterator>
+
+static int64_t getFileSize(const std::string &path) {
+  std::ifstream file(path, std::ios::binary | std::ios::ate);
+  if (!file.is_open()) return -1;
+  return (int64_t)file.tellg();
+}
+
+OfflineQueue::OfflineQueue(IpcClientPool *ipcClientPool, size_t capacity, std::string spillFile, std::function<void(std::vector<WriteBuffer::Write> &writes, const Ipc::PVariable &result)> resultHandler, Metrics::MethodStats *stats)
+    : _ipcClientPool(ipcClientPool), _capacity(capacity), _spillFile(std::move(spillFile)), _resultHandler(std::move(resultHandler)), _stats(stats) {
+  if (!_spillFile.empty()) {
+    //Writes saved by a previous instance or left by a replay which didn't finish are replayed after the connection is established.
+    _replayFile = _spillFile + ".replay";
+    _spilled = getFileSize(_spillFile) > 0 || getFileSize(_replayFile) > 0;
+  }
+  _thread = std::thread(&OfflineQueue::work, this);
+}
+
+OfflineQueue::~OfflineQueue() {
+  {
+    std::lock_guard<std::mutex> guard(_mutex);
+    _stopped = true;
+  }
+  _conditionVariable.notify_all();
+  if (_thread.joinable()) _thread.join();
+
+  std::lock_guard<std::mutex> guard(_mutex);
+  if (!_entries.empty() && !_spillFile.empty()) appendToSpillFile(_entries);
+}
+
+size_t OfflineQueue::size() {
+  std::lock_guard<std::mutex> guard(_mutex);
+  return _entries.size();
+}
+
+bool OfflineQueue::push(const std::string &methodName, const Ipc::PArray &parameters) {
+  std::string key;
+  bool coalesce = WriteBuffer::getKey(methodName, parameters, key);
+
+  std::lock_guard<std::mutex> guard(_mutex);
+  if (_stopped) return false;
+  bool connected = _ipcClientPool->connected();
+  if (connected && !_replaying && !_spilled && _entries.empty()) return false;
+  if (connected) {
+    _replayRequested = true;
+    _conditionVariable.notify_all();
+  }
+
+  if (coalesce) {
+    auto positionIterator = _positions.find(key);
+    if (positionIterator != _positions.end()) {
+      positionIterator->second->write.parameters = parameters;
+      _coalescedCount++;
+      return true;
+    }
+  } else {
+    //Like in the write buffer, later writes to the same key are queued after a write which can't be coalesced.
+    if (WriteBuffer::getAffectedKey(methodName, parameters, key)) _positions.erase(key);
+    else _positions.clear();
+    key.clear();
+  }
+
+  if (_entries.size() >= _capacity) {
+    //The queued writes are moved to the spill file, so it always contains older writes than the queue.
+    if (!_spillFile.empty() && appendToSpillFile(_entries)) {
+      _spilled = true;
+      _spilledCount += _entries.size();
+      _entries.clear();
+      _positions.clear();
+    } else {
+      if (!_entries.front().key.empty()) _positions.erase(_entries.front().key);
+      _entries.pop_front();
+      _droppedCount++;
+    }
+  }
+
+  _entries.push_back(Entry{key, WriteBuffer::Write{methodName, parameters}});
+  if (!key.empty()) _positions.emplace(std::move(key), std::prev(_entries.end()));
+  return true;
+}
+
+void OfflineQueue::replay() {
+  {
+    std::lock_guard<std::mutex> guard(_mutex);
+    _replayRequested = true;
+  }
+  _conditionVariable.notify_all();
+}
+
+void OfflineQueue::writeRecord(std::ofstream &file, const WriteBuffer::Write &write) {
+  //Each record is the size of the encoded request followed by a binary RPC request.
+  std::vector<char> encodedData;
+  _rpcEncoder.encodeRequest(write.methodName, write.parameters, encodedData);
+  auto size = (uint32_t)encodedData.size();
+  file.write((const char *)&size, sizeof(size));
+  file.write(encodedData.data(), encodedData.size());
+}
+
+bool OfflineQueue::appendToSpillFile(const std::list<Entry> &entries) {
+  std::ofstream file(_spillFile, std::ios::binary | std::ios::app);
+  if (!file.is_open()) return false;
+  for (auto &entry : entries) {
+    writeRecord(file, entry.write);
+  }
+  file.flush();
+  return file.good();
+}
+
+void OfflineQueue::readRecords(const std::string &path, std::vector<WriteBuffer::Write> &writes) {
+  //The file might be truncated by a crash while writing, corrupt or not written by this class, so sizes are checked and decoding errors end reading.
+  int64_t remainingSize = getFileSize(path);
+  std::ifstream file(path, std::ios::binary);
+  if (!file.is_open() || remainingSize <= 0) return;
+  try {
+    std::vector<char> encodedData;
+    uint32_t size = 0;
+    while (remainingSize >= (int64_t)sizeof(size) && file.read((char *)&size, sizeof(size))) {
+      remainingSize -= sizeof(size);
+      if (size == 0 || size > kMaxRecordSize || (int64_t)size > remainingSize) break;
+      encodedData.resize(size);
+      if (!file.read(encodedData.data(), size)) break;
+      remainingSize -= size;
+      WriteBuffer::Write write;
+      write.parameters = _rpcDecoder.decodeRequest(encodedData, write.methodName);
+      if (write.methodName.empty() || !write.parameters) break;
+      writes.push_back(std::move(write));
+    }
+  } catch (...) {
+  }
+}
+
+void OfflineQueue::readSpillFile(std::vector<WriteBuffer::Write> &writes) {
+  _spilled = false;
+  //The spilled writes are moved to the replay file, which is only removed after all of them were executed. New writes are spilled to a new file
+  //meanwhile. A replay file left by a replay which didn't finish contains older writes than the spill file.
+  if (getFileSize(_replayFile) < 0) std::rename(_spillFile.c_str(), _replayFile.c_str());
+  else if (getFileSize(_spillFile) > 0) {
+    std::ifstream spillFile(_spillFile, std::ios::binary);
+    std::ofstream replayFile(_replayFile, std::ios::binary | std::ios::app);
+    replayFile << spillFile.rdbuf();
+    replayFile.flush();
+    if (replayFile.good()) std::remove(_spillFile.c_str());
+  }
+  readRecords(_replayFile, writes);
+}
+
+void OfflineQueue::takeWrites(std::vector<WriteBuffer::Write> &writes) {
+  //Spilled writes are older than the writes in memory.
+  std::vector<WriteBuffer::Write> spilledWrites;
+  if (_spilled) readSpillFile(spilledWrites);
+  writes.reserve(spilledWrites.size() + _entries.size());
+
+  std::unordered_map<std::string, size_t> positions;
+  auto add = [&](WriteBuffer::Write &write) {
+    std::string key;
+    if (WriteBuffer::getKey(write.methodName, write.parameters, key)) {
+      auto positionIterator = positions.find(key);
+      if (positionIterator != positions.end()) {
+        writes[positionIterator->second].parameters = std::move(write.parameters);
+        return;
+      }
+      positions.emplace(std::move(key), writes.size());
+    } else if (WriteBuffer::getAffectedKey(write.methodName, write.parameters, key)) positions.erase(key);
+    else positions.clear();
+    writes.push_back(std::move(write));
+  };
+  for (auto &write : spilledWrites) {
+    add(write);
+  }
+  for (auto &entry : _entries) {
+    add(entry.write);
+  }
+  _entries.clear();
+  _positions.clear();
+}
+
+void OfflineQueue::requeue(std::vector<WriteBuffer::Write> &writes, size_t offset) {
+  std::lock_guard<std::mutex> guard(_mutex);
+  if (!_spillFile.empty()) {
+    //The unsent writes replace the replay file. Writes spilled meanwhile are newer, so they are appended.
+    std::string temporaryFile = _spillFile + ".tmp";
+    {
+      std::ofstream file(temporaryFile, std::ios::binary | std::ios::trunc);
+      if (file.is_open()) {
+        for (size_t i = offset; i < writes.size(); i++) {
+          writeRecord(file, writes[i]);
+        }
+        if (getFileSize(_spillFile) > 0) {
+          std::ifstream spillFile(_spillFile, std::ios::binary);
+          file << spillFile.rdbuf();
+        }
+        file.flush();
+      }
+      if (file.is_open() && file.good()) {
+        file.close();
+        if (std::rename(temporaryFile.c_str(), _spillFile.c_str()) == 0) {
+          std::remove(_replayFile.c_str());
+          _spilled = true;
+          return;
+        }
+      }
+    }
+    std::remove(temporaryFile.c_str());
+  }
+
+  for (size_t i = writes.size(); i-- > offset;) {
+    std::string key;
+    if (WriteBuffer::getKey(writes[i].methodName, writes[i].parameters, key)) {
+      if (_positions.find(key) != _positions.end()) continue;
+    } else key.clear();
+    _entries.push_front(Entry{key, std::move(writes[i])});
+    if (!key.empty()) _positions.emplace(std::move(key), _entries.begin());
+  }
+}
+
+void OfflineQueue::replayWrites() {
+  std::vector<WriteBuffer::Write> writes;
+  {
+    std::lock_guard<std::mutex> guard(_mutex);
+    if (!_ipcClientPool->connected()) return;
+    takeWrites(writes);
+    if (writes.empty()) {
+      if (!_replayFile.empty()) std::remove(_replayFile.c_str()); //Only contained invalid records
+      return;
+    }
+    _replaying = true;
+  }
+
+  for (size_t offset = 0; offset < writes.size(); offset += kReplayBatchSize) {
+    size_t end = std::min(offset + kReplayBatchSize, writes.size());
+    auto callArray = std::make_shared<Ipc::Variable>(Ipc::VariableType::tArray);
+    callArray->arrayValue->reserve(end - offset);
+    for (size_t i = offset; i < end; i++) {
+      auto callStruct = std::make_shared<Ipc::Variable>(Ipc::VariableType::tStruct);
+      callStruct->structValue->emplace("methodName", std::make_shared<Ipc::Variable>(writes[i].methodName));
+      callStruct->structValue->emplace("params", std::make_shared<Ipc::Variable>(writes[i].parameters));
+      callArray->arrayValue->emplace_back(std::move(callStruct));
+    }
+    auto parameters = std::make_shared<Ipc::Array>();
+    parameters->emplace_back(std::move(callArray));
+
+    auto result = _ipcClientPool->invoke("system.multicall", parameters, _stats);
+    if (result->errorStruct && !_ipcClientPool->connected()) {
+      //The connection was lost again, the writes are replayed after the next connect.
+      requeue(writes, offset);
+      std::lock_guard<std::mutex> guard(_mutex);
+      _replaying = false;
+      return;
+    }
+
+    std::vector<WriteBuffer::Write> batch(std::make_move_iterator(writes.begin() + offset), std::make_move_iterator(writes.begin() + end));
+    _replayedCount += batch.size();
+    if (_resultHandler) _resultHandler(batch, result);
+  }
+
+  std::lock_guard<std::mutex> guard(_mutex);
+  if (!_replayFile.empty()) std::remove(_replayFile.c_str()); //All spilled writes were executed
+  _replaying = false;
+}
+
+void OfflineQueue::work() {
+  std::unique_lock<std::mutex> lock(_mutex);
+  while (!_stopped) {
+    //Also checks periodically, so writes loaded from the spill file are replayed when the connection already exists.
+    _conditionVariable.wait_for(lock, kCheckInterval, [&] { return _stopped || _replayRequested; });
+    if (_stopped) break;
+    _replayRequested = false;
+    lock.unlock();
+    replayWrites();
+    lock.lock();
+  }
+  lock.unlock();
+  replayWrites(); //Like the write buffer, the result handler is only called by the background thread.
+}
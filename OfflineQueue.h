@@ -0,0 +1,144 @@
+/* Copyright 2013-2019 Homegear GmbH
+ *
+ * Homegear is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * Homegear is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with Homegear.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ *
+ * In addition, as a special exception, the copyright holders give
+ * permission to link the code of portions of this program with the
+ * OpenSSL library under certain conditions as described in each
+ * individual source file, and distribute linked combinations
+ * including the two.
+ * You must obey the GNU Lesser General Public License in all respects
+ * for all of the code used other than OpenSSL.  If you modify
+ * file(s) with this exception, you may extend this exception to your
+ * version of the file(s), but you are not obligated to do so.  If you
+ * do not wish to do so, delete this exception statement from your
+ * version.  If you delete this exception statement from all source
+ * files in the program, then also delete it here.
+*/
+
+#ifndef OFFLINEQUEUE_H_
+#define OFFLINEQUEUE_H_
+
+#include "WriteBuffer.h"
+
+#include <homegear-ipc/RpcDecoder.h>
+#include <homegear-ipc/RpcEncoder.h>
+
+#include <fstream>
+#include <list>
+
+/**
+ * Queue for setValue, setSystemVariable and setMetadata calls made while there is no connection to Homegear. Writes to the same key are coalesced. When
+ * the queue is full, the queued writes are moved to the spill file or, without a spill file, the oldest write is dropped. After the connection is
+ * established, a background thread replays the spilled and queued writes in order as "system.multicall" bursts. Writes made before the replay finished are
+ * queued as well, so they are not overtaken by older values.
+ */
+class OfflineQueue {
+ public:
+  /**
+   * @param capacity Maximum number of writes kept in memory.
+   * @param spillFile Optional. The queued writes are appended to this file when the capacity is reached. Writes still queued on destruction are saved to it and replayed by
+   * the next instance using the same file.
+   * @param resultHandler Called by the background thread after each burst, see WriteBuffer.
+   * @param stats Optional. Records the latency of the bursts.
+   */
+  OfflineQueue(IpcClientPool *ipcClientPool, size_t capacity, std::string spillFile, std::function<void(std::vector<WriteBuffer::Write> &writes, const Ipc::PVariable &result)> resultHandler, Metrics::MethodStats *stats = nullptr);
+
+  /**
+   * Replays the queued writes when connected, saves the remaining ones to the spill file and stops the background thread.
+   */
+  ~OfflineQueue();
+
+  size_t size();
+  uint64_t coalescedCount() const { return _coalescedCount; }
+  uint64_t spilledCount() const { return _spilledCount; }
+  uint64_t droppedCount() const { return _droppedCount; }
+  uint64_t replayedCount() const { return _replayedCount; }
+
+  /**
+   * Queues a write when there is no connection or older writes are not replayed yet. Returns false when the write should be executed directly.
+   */
+  bool push(const std::string &methodName, const Ipc::PArray &parameters);
+
+  /**
+   * Wakes up the background thread to replay the queued writes. Does not block, so it can be called from the IPC thread.
+   */
+  void replay();
+ private:
+  struct Entry {
+    std::string key; //Empty when the write can't be coalesced
+    WriteBuffer::Write write;
+  };
+
+  static constexpr size_t kReplayBatchSize = 1000;
+  static constexpr std::chrono::seconds kCheckInterval{1};
+  static constexpr uint32_t kMaxRecordSize = 64 * 1024 * 1024; //Larger records in the spill file are treated as corrupt
+
+  IpcClientPool *_ipcClientPool = nullptr;
+  size_t _capacity = 0;
+  std::string _spillFile;
+  std::string _replayFile; //The spill file is renamed to this file while its writes are replayed
+  std::function<void(std::vector<WriteBuffer::Write> &writes, const Ipc::PVariable &result)> _resultHandler;
+  Metrics::MethodStats *_stats = nullptr;
+  Ipc::RpcEncoder _rpcEncoder;
+  Ipc::RpcDecoder _rpcDecoder;
+
+  std::mutex _mutex;
+  std::condition_variable _conditionVariable;
+  bool _stopped = false;
+  bool _replayRequested = false;
+  bool _replaying = false; //Set while a burst is sent, new writes are queued meanwhile
+  bool _spilled = false; //The spill file or the replay file contains writes
+  std::list<Entry> _entries; //In the order of the first write of each key
+  std::unordered_map<std::string, std::list<Entry>::iterator> _positions;
+  std::atomic<uint64_t> _coalescedCount{0};
+  std::atomic<uint64_t> _spilledCount{0};
+  std::atomic<uint64_t> _droppedCount{0};
+  std::atomic<uint64_t> _replayedCount{0};
+  std::thread _thread;
+
+  void writeRecord(std::ofstream &file, const WriteBuffer::Write &write);
+
+  /**
+   * Appends the writes of entries to the spill file. _mutex must be locked.
+   */
+  bool appendToSpillFile(const std::list<Entry> &entries);
+
+  /**
+   * Reads the records of a spill file until the end or the first invalid record.
+   */
+  void readRecords(const std::string &path, std::vector<WriteBuffer::Write> &writes);
+
+  /**
+   * Moves the spill file to the replay file and reads it. The replay file is removed after all writes were executed. _mutex must be locked.
+   */
+  void readSpillFile(std::vector<WriteBuffer::Write> &writes);
+
+  /**
+   * Moves the spilled and queued writes to writes, coalescing them again. _mutex must be locked.
+   */
+  void takeWrites(std::vector<WriteBuffer::Write> &writes);
+
+  /**
+   * Puts writes which couldn't be replayed back in front of the queue. With a spill file, they replace the replay file. Otherwise they are queued in
+   * memory and keys written again meanwhile keep the newer value.
+   */
+  void requeue(std::vector<WriteBuffer::Write> &writes, size_t offset);
+
+  void replayWrites();
+  void work();
+};
+
+#endif
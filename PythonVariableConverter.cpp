@@ -29,108 +29,794 @@
 
 #include "PythonVariableConverter.h"
 
-Ipc::PVariable PythonVariableConverter::getVariable(PyObject *value) {
-  Ipc::PVariable variable;
+#include <cstring>
+
+
+/**
+ * Exports the binary value of a Variable through the buffer protocol. Keeps the Variable alive as long as a memoryview references it.
+ */
+typedef struct {
+  PyObject_HEAD
+  Ipc::PVariable *variable = nullptr;
+} BinaryBuffer;
+
+static void BinaryBuffer_dealloc(BinaryBuffer *self) {
+  if (self->variable) {
+    delete self->variable;
+    self->variable = nullptr;
+  }
+  PyTypeObject *type = Py_TYPE(self);
+  type->tp_free((PyObject *)self);
+  Py_DECREF(type); //Instances of heap types hold a reference to their type.
+}
+
+static int BinaryBuffer_getBuffer(BinaryBuffer *self, Py_buffer *view, int flags) {
+  static char emptyBuffer[1] = {0};
+  auto &binaryValue = (*self->variable)->binaryValue;
+  return PyBuffer_FillInfo(view, (PyObject *)self, binaryValue.empty() ? emptyBuffer : binaryValue.data(), (Py_ssize_t)binaryValue.size(), 1, flags);
+}
+
+#ifndef Py_TPFLAGS_IMMUTABLETYPE
+#define Py_TPFLAGS_IMMUTABLETYPE 0
+#endif
+#ifndef Py_TPFLAGS_DISALLOW_INSTANTIATION
+#define Py_TPFLAGS_DISALLOW_INSTANTIATION 0
+#endif
+
+static PyType_Slot BinaryBufferSlots[] = {
+    {Py_tp_dealloc, (void *)BinaryBuffer_dealloc},
+    {Py_bf_getbuffer, (void *)BinaryBuffer_getBuffer},
+    {Py_tp_doc, (void *)"Read-only buffer referencing binary data received from Homegear."},
+    {0, nullptr}
+};
+
+static PyType_Spec BinaryBufferSpec = {
+    "homegear.BinaryBuffer",
+    sizeof(BinaryBuffer),
+    0,
+    Py_TPFLAGS_DEFAULT | Py_TPFLAGS_IMMUTABLETYPE | Py_TPFLAGS_DISALLOW_INSTANTIATION,
+    BinaryBufferSlots
+};
+
+/**
+ * Exports a typed one-dimensional array through the buffer protocol.
+ */
+typedef struct {
+  PyObject_HEAD
+  std::vector<char> *data = nullptr;
+  char format[4]{};
+  Py_ssize_t itemSize = 1;
+  Py_ssize_t shape = 0;
+} Column;
+
+static void Column_dealloc(Column *self) {
+  if (self->data) {
+    delete self->data;
+    self->data = nullptr;
+  }
+  PyTypeObject *type = Py_TYPE(self);
+  type->tp_free((PyObject *)self);
+  Py_DECREF(type);
+}
+
+static int Column_getBuffer(Column *self, Py_buffer *view, int flags) {
+  if ((flags & PyBUF_WRITABLE) == PyBUF_WRITABLE) {
+    PyErr_SetString(PyExc_BufferError, "Column is read-only.");
+    view->obj = nullptr;
+    return -1;
+  }
+  static char emptyBuffer[8] = {0};
+  Py_INCREF(self);
+  view->obj = (PyObject *)self;
+  view->buf = self->data->empty() ? emptyBuffer : self->data->data();
+  view->len = (Py_ssize_t)self->data->size();
+  view->readonly = 1;
+  view->itemsize = self->itemSize;
+  view->format = (flags & PyBUF_FORMAT) == PyBUF_FORMAT ? self->format : nullptr;
+  view->ndim = 1;
+  view->shape = (flags & PyBUF_ND) == PyBUF_ND ? &self->shape : nullptr;
+  view->strides = (flags & PyBUF_STRIDES) == PyBUF_STRIDES ? &self->itemSize : nullptr;
+  view->suboffsets = nullptr;
+  view->internal = nullptr;
+  return 0;
+}
+
+static PyType_Slot ColumnSlots[] = {
+    {Py_tp_dealloc, (void *)Column_dealloc},
+    {Py_bf_getbuffer, (void *)Column_getBuffer},
+    {Py_tp_doc, (void *)"Read-only typed array returned by getValueColumns()."},
+    {0, nullptr}
+};
+
+static PyType_Spec ColumnSpec = {
+    "homegear.Column",
+    sizeof(Column),
+    0,
+    Py_TPFLAGS_DEFAULT | Py_TPFLAGS_IMMUTABLETYPE | Py_TPFLAGS_DISALLOW_INSTANTIATION,
+    ColumnSlots
+};
+
+#ifndef Py_BEGIN_CRITICAL_SECTION
+#define Py_BEGIN_CRITICAL_SECTION(op) {
+#define Py_END_CRITICAL_SECTION() }
+#endif
+
+/**
+ * Read-only proxy for a struct (HomegearStruct) or an array (HomegearArray). Elements are converted on first access and cached, so only the parts of a
+ * large result that are used are converted. Holds a reference to the owner of the converter, which keeps the converter alive.
+ */
+typedef struct {
+  PyObject_HEAD
+  Ipc::PVariable *variable = nullptr;
+  PythonVariableConverter *converter = nullptr;
+  PyObject *owner = nullptr;
+  std::shared_ptr<Metrics::Counter> *byteCounter = nullptr;
+  bool binaryAsMemoryView = false;
+  PyObject *structChildren = nullptr; //HomegearStruct: dict of key => converted element, created on first access
+  std::vector<PyObject *> *arrayChildren = nullptr; //HomegearArray: converted elements by index, nullptr when not converted yet
+} LazyContainer;
+
+static void LazyContainer_dealloc(LazyContainer *self) {
+  Py_CLEAR(self->structChildren);
+  if (self->arrayChildren) {
+    for (auto child : *self->arrayChildren) {
+      Py_XDECREF(child);
+    }
+    delete self->arrayChildren;
+    self->arrayChildren = nullptr;
+  }
+  if (self->variable) {
+    delete self->variable;
+    self->variable = nullptr;
+  }
+  if (self->byteCounter) {
+    delete self->byteCounter;
+    self->byteCounter = nullptr;
+  }
+  Py_CLEAR(self->owner);
+  PyTypeObject *type = Py_TYPE(self);
+  type->tp_free((PyObject *)self);
+  Py_DECREF(type);
+}
+
+/**
+ * Converts the whole container to a dict or list. Used for comparisons and repr().
+ */
+static PyObject *LazyContainer_materialize(LazyContainer *self, PyObject *unused) {
+  return self->converter->getPythonVariable(*self->variable, *self->byteCounter, self->binaryAsMemoryView, false);
+}
+
+static PyObject *LazyContainer_richCompare(LazyContainer *self, PyObject *other, int op) {
+  if (op != Py_EQ && op != Py_NE) Py_RETURN_NOTIMPLEMENTED;
+  PyObject *value = LazyContainer_materialize(self, nullptr);
+  if (!value) return nullptr;
+  PyObject *result = PyObject_RichCompare(value, other, op);
+  Py_DECREF(value);
+  return result;
+}
+
+static PyObject *LazyContainer_repr(LazyContainer *self) {
+  PyObject *value = LazyContainer_materialize(self, nullptr);
+  if (!value) return nullptr;
+  PyObject *result = PyObject_Repr(value);
+  Py_DECREF(value);
+  return result;
+}
+
+// {{{ HomegearStruct
+static Py_ssize_t LazyStruct_length(LazyContainer *self) {
+  return (Py_ssize_t)(*self->variable)->structValue->size();
+}
+
+/**
+ * Returns a new reference to the converted element or nullptr with KeyError set. Must be called within a critical section on self.
+ */
+static PyObject *LazyStruct_lookup(LazyContainer *self, PyObject *key) {
+  if (self->structChildren) {
+    PyObject *value = PyDict_GetItemWithError(self->structChildren, key);
+    if (value) {
+      Py_INCREF(value);
+      return value;
+    }
+    if (PyErr_Occurred()) return nullptr;
+  }
+
+  if (!PyUnicode_Check(key)) {
+    PyErr_SetObject(PyExc_KeyError, key);
+    return nullptr;
+  }
+  Py_ssize_t keySize = 0;
+  const char *utf8Key = PyUnicode_AsUTF8AndSize(key, &keySize);
+  if (!utf8Key) return nullptr;
+  auto &structValue = *(*self->variable)->structValue;
+  auto structIterator = structValue.find(std::string(utf8Key, keySize));
+  if (structIterator == structValue.end()) {
+    PyErr_SetObject(PyExc_KeyError, key);
+    return nullptr;
+  }
+
+  PyObject *value = self->converter->getPythonVariable(structIterator->second, *self->byteCounter, self->binaryAsMemoryView, true);
+  if (!value) return nullptr;
+  if (!self->structChildren) self->structChildren = PyDict_New();
+  if (!self->structChildren || PyDict_SetItem(self->structChildren, key, value) == -1) {
+    Py_DECREF(value);
+    return nullptr;
+  }
+  return value;
+}
+
+static PyObject *LazyStruct_getItem(LazyContainer *self, PyObject *key) {
+  PyObject *value = nullptr;
+  Py_BEGIN_CRITICAL_SECTION(self);
+  value = LazyStruct_lookup(self, key);
+  Py_END_CRITICAL_SECTION();
+  return value;
+}
+
+static int LazyStruct_contains(LazyContainer *self, PyObject *key) {
+  if (!PyUnicode_Check(key)) return 0;
+  Py_ssize_t keySize = 0;
+  const char *utf8Key = PyUnicode_AsUTF8AndSize(key, &keySize);
+  if (!utf8Key) return -1;
+  auto &structValue = *(*self->variable)->structValue;
+  return structValue.find(std::string(utf8Key, keySize)) != structValue.end() ? 1 : 0;
+}
+
+/**
+ * Returns a new list of the keys.
+ */
+static PyObject *LazyStruct_getKeyList(LazyContainer *self) {
+  auto &structValue = *(*self->variable)->structValue;
+  PyObject *keys = PyList_New(structValue.size());
+  if (!keys) return nullptr;
+  Py_ssize_t i = 0;
+  for (auto &element : structValue) {
+    PyObject *key = self->converter->getKey(element.first);
+    if (!key) {
+      Py_DECREF(keys);
+      return nullptr;
+    }
+    PyList_SET_ITEM(keys, i++, key);
+  }
+  return keys;
+}
+
+static PyObject *LazyStruct_keys(LazyContainer *self, PyObject *unused) {
+  return self->converter->getMappingView((PyObject *)self, PythonVariableConverter::MappingView::kKeys);
+}
+
+static PyObject *LazyStruct_values(LazyContainer *self, PyObject *unused) {
+  return self->converter->getMappingView((PyObject *)self, PythonVariableConverter::MappingView::kValues);
+}
+
+static PyObject *LazyStruct_items(LazyContainer *self, PyObject *unused) {
+  return self->converter->getMappingView((PyObject *)self, PythonVariableConverter::MappingView::kItems);
+}
+
+static PyObject *LazyStruct_get(LazyContainer *self, PyObject *args) {
+  PyObject *key = nullptr;
+  PyObject *defaultValue = Py_None;
+  if (!PyArg_UnpackTuple(args, "get", 1, 2, &key, &defaultValue)) return nullptr;
+  PyObject *value = LazyStruct_getItem(self, key);
+  if (value || !PyErr_ExceptionMatches(PyExc_KeyError)) return value;
+  PyErr_Clear();
+  Py_INCREF(defaultValue);
+  return defaultValue;
+}
+
+static PyObject *LazyStruct_iter(LazyContainer *self) {
+  PyObject *keys = LazyStruct_getKeyList(self);
+  if (!keys) return nullptr;
+  PyObject *iterator = PyObject_GetIter(keys);
+  Py_DECREF(keys);
+  return iterator;
+}
+
+static PyMethodDef LazyStructMethods[] = {
+    {"keys", (PyCFunction)LazyStruct_keys, METH_NOARGS, "keys()\nReturns a KeysView of the struct."},
+    {"values", (PyCFunction)LazyStruct_values, METH_NOARGS, "values()\nReturns a ValuesView of the struct. Elements are converted while iterating."},
+    {"items", (PyCFunction)LazyStruct_items, METH_NOARGS, "items()\nReturns an ItemsView of the struct. Elements are converted while iterating."},
+    {"get", (PyCFunction)LazyStruct_get, METH_VARARGS, "get(key, default=None)"},
+    {"toPython", (PyCFunction)LazyContainer_materialize, METH_NOARGS, "toPython()\nConverts the struct and all nested elements to a dict."},
+    {nullptr, nullptr, 0, nullptr}
+};
+
+static PyType_Slot LazyStructSlots[] = {
+    {Py_tp_dealloc, (void *)LazyContainer_dealloc},
+    {Py_tp_repr, (void *)LazyContainer_repr},
+    {Py_tp_richcompare, (void *)LazyContainer_richCompare},
+    {Py_tp_hash, (void *)PyObject_HashNotImplemented},
+    {Py_tp_iter, (void *)LazyStruct_iter},
+    {Py_tp_methods, LazyStructMethods},
+    {Py_mp_length, (void *)LazyStruct_length},
+    {Py_mp_subscript, (void *)LazyStruct_getItem},
+    {Py_sq_contains, (void *)LazyStruct_contains},
+    {Py_tp_doc, (void *)"Read-only mapping referencing a struct received from Homegear. Elements are converted on first access."},
+    {0, nullptr}
+};
+
+static PyType_Spec LazyStructSpec = {
+    "homegear.HomegearStruct",
+    sizeof(LazyContainer),
+    0,
+    Py_TPFLAGS_DEFAULT | Py_TPFLAGS_IMMUTABLETYPE | Py_TPFLAGS_DISALLOW_INSTANTIATION,
+    LazyStructSlots
+};
+// }}}
+
+// {{{ HomegearArray
+static Py_ssize_t LazyArray_length(LazyContainer *self) {
+  return (Py_ssize_t)(*self->variable)->arrayValue->size();
+}
+
+static PyObject *LazyArray_getItem(LazyContainer *self, Py_ssize_t index) {
+  auto &arrayValue = *(*self->variable)->arrayValue;
+  if (index < 0 || index >= (Py_ssize_t)arrayValue.size()) {
+    PyErr_SetString(PyExc_IndexError, "HomegearArray index out of range");
+    return nullptr;
+  }
+
+  PyObject *value = nullptr;
+  Py_BEGIN_CRITICAL_SECTION(self);
+  if (!self->arrayChildren) self->arrayChildren = new std::vector<PyObject *>(arrayValue.size(), nullptr);
+  PyObject *&child = (*self->arrayChildren)[index];
+  if (!child) child = self->converter->getPythonVariable(arrayValue[index], *self->byteCounter, self->binaryAsMemoryView, true);
+  value = child;
+  Py_XINCREF(value);
+  Py_END_CRITICAL_SECTION();
+  return value;
+}
+
+/**
+ * Iterator returned by reversed(HomegearArray).
+ */
+typedef struct {
+  PyObject_HEAD
+  PyObject *array = nullptr; //Set to nullptr when all elements were returned
+  Py_ssize_t index = 0; //Next index
+} LazyArrayReverseIterator;
+
+static void LazyArrayReverseIterator_dealloc(LazyArrayReverseIterator *self) {
+  Py_CLEAR(self->array);
+  PyTypeObject *type = Py_TYPE(self);
+  type->tp_free((PyObject *)self);
+  Py_DECREF(type);
+}
+
+static PyObject *LazyArrayReverseIterator_next(LazyArrayReverseIterator *self) {
+  PyObject *value = nullptr;
+  Py_BEGIN_CRITICAL_SECTION(self);
+  if (self->array && self->index >= 0 && self->index < LazyArray_length((LazyContainer *)self->array)) {
+    value = LazyArray_getItem((LazyContainer *)self->array, self->index--);
+  } else Py_CLEAR(self->array);
+  Py_END_CRITICAL_SECTION();
+  return value;
+}
+
+static PyType_Slot LazyArrayReverseIteratorSlots[] = {
+    {Py_tp_dealloc, (void *)LazyArrayReverseIterator_dealloc},
+    {Py_tp_iter, (void *)PyObject_SelfIter},
+    {Py_tp_iternext, (void *)LazyArrayReverseIterator_next},
+    {0, nullptr}
+};
+
+static PyType_Spec LazyArrayReverseIteratorSpec = {
+    "homegear.HomegearArrayReverseIterator",
+    sizeof(LazyArrayReverseIterator),
+    0,
+    Py_TPFLAGS_DEFAULT | Py_TPFLAGS_IMMUTABLETYPE | Py_TPFLAGS_DISALLOW_INSTANTIATION,
+    LazyArrayReverseIteratorSlots
+};
+
+static PyObject *LazyArray_reversed(LazyContainer *self, PyObject *unused) {
+  return self->converter->getReverseIterator((PyObject *)self);
+}
+
+static PyObject *LazyArray_count(LazyContainer *self, PyObject *value) {
+  Py_ssize_t count = 0;
+  Py_ssize_t size = LazyArray_length(self);
+  for (Py_ssize_t i = 0; i < size; i++) {
+    PyObject *element = LazyArray_getItem(self, i);
+    int equal = element ? PyObject_RichCompareBool(element, value, Py_EQ) : -1;
+    Py_XDECREF(element);
+    if (equal == -1) return nullptr;
+    if (equal) count++;
+  }
+  return PyLong_FromSsize_t(count);
+}
+
+static PyObject *LazyArray_index(LazyContainer *self, PyObject *args) {
+  PyObject *value = nullptr;
+  Py_ssize_t start = 0;
+  Py_ssize_t stop = PY_SSIZE_T_MAX;
+  if (!PyArg_ParseTuple(args, "O|nn:index", &value, &start, &stop)) return nullptr;
+  Py_ssize_t size = LazyArray_length(self);
+  if (start < 0) start = start + size < 0 ? 0 : start + size;
+  if (stop < 0) stop += size;
+  if (stop > size) stop = size;
+  for (Py_ssize_t i = start; i < stop; i++) {
+    PyObject *element = LazyArray_getItem(self, i);
+    int equal = element ? PyObject_RichCompareBool(element, value, Py_EQ) : -1;
+    Py_XDECREF(element);
+    if (equal == -1) return nullptr;
+    if (equal) return PyLong_FromSsize_t(i);
+  }
+  PyErr_SetString(PyExc_ValueError, "HomegearArray.index(x): x not in array");
+  return nullptr;
+}
+
+static PyObject *LazyArray_subscript(LazyContainer *self, PyObject *key) {
+  if (PyIndex_Check(key)) {
+    Py_ssize_t index = PyNumber_AsSsize_t(key, PyExc_IndexError);
+    if (index == -1 && PyErr_Occurred()) return nullptr;
+    if (index < 0) index += LazyArray_length(self);
+    return LazyArray_getItem(self, index);
+  } else if (PySlice_Check(key)) {
+    Py_ssize_t start = 0, stop = 0, step = 0;
+    if (PySlice_Unpack(key, &start, &stop, &step) < 0) return nullptr;
+    Py_ssize_t size = PySlice_AdjustIndices(LazyArray_length(self), &start, &stop, step);
+    PyObject *list = PyList_New(size);
+    if (!list) return nullptr;
+    for (Py_ssize_t i = 0, index = start; i < size; i++, index += step) {
+      PyObject *value = LazyArray_getItem(self, index);
+      if (!value) {
+        Py_DECREF(list);
+        return nullptr;
+      }
+      PyList_SET_ITEM(list, i, value);
+    }
+    return list;
+  }
+  PyErr_Format(PyExc_TypeError, "HomegearArray indices must be integers or slices, not %.200s", Py_TYPE(key)->tp_name);
+  return nullptr;
+}
+
+static PyMethodDef LazyArrayMethods[] = {
+    {"index", (PyCFunction)LazyArray_index, METH_VARARGS, "index(value, start=0, stop=len)\nReturns the first index of value. Raises ValueError if it is not present."},
+    {"count", (PyCFunction)LazyArray_count, METH_O, "count(value)\nReturns the number of occurrences of value."},
+    {"__reversed__", (PyCFunction)LazyArray_reversed, METH_NOARGS, "__reversed__()\nReturns a reverse iterator."},
+    {"toPython", (PyCFunction)LazyContainer_materialize, METH_NOARGS, "toPython()\nConverts the array and all nested elements to a list."},
+    {nullptr, nullptr, 0, nullptr}
+};
+
+static PyType_Slot LazyArraySlots[] = {
+    {Py_tp_dealloc, (void *)LazyContainer_dealloc},
+    {Py_tp_repr, (void *)LazyContainer_repr},
+    {Py_tp_richcompare, (void *)LazyContainer_richCompare},
+    {Py_tp_hash, (void *)PyObject_HashNotImplemented},
+    {Py_tp_iter, (void *)PySeqIter_New},
+    {Py_tp_methods, LazyArrayMethods},
+    {Py_sq_length, (void *)LazyArray_length},
+    {Py_sq_item, (void *)LazyArray_getItem},
+    {Py_mp_length, (void *)LazyArray_length},
+    {Py_mp_subscript, (void *)LazyArray_subscript},
+    {Py_tp_doc, (void *)"Read-only sequence referencing an array received from Homegear. Elements are converted on first access."},
+    {0, nullptr}
+};
+
+static PyType_Spec LazyArraySpec = {
+    "homegear.HomegearArray",
+    sizeof(LazyContainer),
+    0,
+    Py_TPFLAGS_DEFAULT | Py_TPFLAGS_IMMUTABLETYPE | Py_TPFLAGS_DISALLOW_INSTANTIATION,
+    LazyArraySlots
+};
+// }}}
+
+/**
+ * Creates a heap type from spec and registers it as virtual subclass of the passed collections.abc class, so isinstance() checks for Mapping or
+ * Sequence succeed.
+ */
+static PyObject *PythonVariableConverter_createAbcType(PyType_Spec *spec, const char *abcName) {
+  PyObject *type = PyType_FromSpec(spec);
+  if (!type) return nullptr;
+#if PY_VERSION_HEX < 0x030A0000
+  ((PyTypeObject *)type)->tp_new = nullptr;
+#endif
+  PyObject *abcModule = PyImport_ImportModule("collections.abc");
+  PyObject *abcClass = abcModule ? PyObject_GetAttrString(abcModule, abcName) : nullptr;
+  PyObject *result = abcClass ? PyObject_CallMethod(abcClass, "register", "(O)", type) : nullptr;
+  Py_XDECREF(abcClass);
+  Py_XDECREF(abcModule);
+  if (!result) {
+    Py_DECREF(type);
+    return nullptr;
+  }
+  Py_DECREF(result);
+  return type;
+}
+
+PythonVariableConverter::~PythonVariableConverter() {
+  for (auto &key : _keys) {
+    Py_DECREF(key.second);
+  }
+  _keys.clear();
+  Py_CLEAR(_binaryBufferType);
+  Py_CLEAR(_columnType);
+  Py_CLEAR(_lazyStructType);
+  Py_CLEAR(_lazyArrayType);
+  Py_CLEAR(_reverseIteratorType);
+  for (auto &mappingViewType : _mappingViewTypes) {
+    Py_CLEAR(mappingViewType);
+  }
+}
+
+int PythonVariableConverter::init(PyObject *owner) {
+  _owner = owner;
+  _binaryBufferType = PyType_FromSpec(&BinaryBufferSpec);
+  if (!_binaryBufferType) return -1;
+#if PY_VERSION_HEX < 0x030A0000
+  ((PyTypeObject *)_binaryBufferType)->tp_new = nullptr; //Py_TPFLAGS_DISALLOW_INSTANTIATION is not available
+#endif
+  _columnType = PyType_FromSpec(&ColumnSpec);
+  if (!_columnType) return -1;
+#if PY_VERSION_HEX < 0x030A0000
+  ((PyTypeObject *)_columnType)->tp_new = nullptr;
+#endif
+  _lazyStructType = PythonVariableConverter_createAbcType(&LazyStructSpec, "Mapping");
+  if (!_lazyStructType) return -1;
+  _lazyArrayType = PythonVariableConverter_createAbcType(&LazyArraySpec, "Sequence");
+  if (!_lazyArrayType) return -1;
+  _reverseIteratorType = PyType_FromSpec(&LazyArrayReverseIteratorSpec);
+  if (!_reverseIteratorType) return -1;
+#if PY_VERSION_HEX < 0x030A0000
+  ((PyTypeObject *)_reverseIteratorType)->tp_new = nullptr;
+#endif
+
+  PyObject *abcModule = PyImport_ImportModule("collections.abc");
+  if (!abcModule) return -1;
+  const char *mappingViewNames[] = {"KeysView", "ValuesView", "ItemsView"};
+  for (size_t i = 0; i < _mappingViewTypes.size(); i++) {
+    _mappingViewTypes[i] = PyObject_GetAttrString(abcModule, mappingViewNames[i]);
+    if (!_mappingViewTypes[i]) {
+      Py_DECREF(abcModule);
+      return -1;
+    }
+  }
+  Py_DECREF(abcModule);
+  return 0;
+}
+
+PyObject *PythonVariableConverter::getLazyContainer(const Ipc::PVariable &input, const std::shared_ptr<Metrics::Counter> &byteCounter, bool binaryAsMemoryView) {
+  auto type = (PyTypeObject *)(input->type == Ipc::VariableType::tStruct ? _lazyStructType : _lazyArrayType);
+  auto container = (LazyContainer *)type->tp_alloc(type, 0);
+  if (!container) return nullptr;
+  container->variable = new Ipc::PVariable(input);
+  container->converter = this;
+  container->byteCounter = new std::shared_ptr<Metrics::Counter>(byteCounter);
+  container->binaryAsMemoryView = binaryAsMemoryView;
+  Py_XINCREF(_owner);
+  container->owner = _owner;
+  return (PyObject *)container;
+}
+
+PyObject *PythonVariableConverter::getMappingView(PyObject *lazyStruct, MappingView view) {
+  return PyObject_CallFunctionObjArgs(_mappingViewTypes[(size_t)view], lazyStruct, nullptr);
+}
+
+PyObject *PythonVariableConverter::getReverseIterator(PyObject *lazyArray) {
+  auto type = (PyTypeObject *)_reverseIteratorType;
+  auto iterator = (LazyArrayReverseIterator *)type->tp_alloc(type, 0);
+  if (!iterator) return nullptr;
+  Py_INCREF(lazyArray);
+  iterator->array = lazyArray;
+  iterator->index = LazyArray_length((LazyContainer *)lazyArray) - 1;
+  return (PyObject *)iterator;
+}
+
+PyObject *PythonVariableConverter::getColumn(std::vector<char> &&data, const char *format, Py_ssize_t itemSize) {
+  auto type = (PyTypeObject *)_columnType;
+  auto column = (Column *)type->tp_alloc(type, 0);
+  if (!column) return nullptr;
+  column->itemSize = itemSize;
+  column->shape = (Py_ssize_t)data.size() / itemSize;
+  strncpy(column->format, format, sizeof(column->format) - 1);
+  column->data = new std::vector<char>(std::move(data));
+  PyObject *memoryView = PyMemoryView_FromObject((PyObject *)column);
+  Py_DECREF(column);
+  return memoryView;
+}
+
+PyObject *PythonVariableConverter::getBinaryMemoryView(const Ipc::PVariable &input) {
+  auto type = (PyTypeObject *)_binaryBufferType;
+  auto buffer = (BinaryBuffer *)type->tp_alloc(type, 0);
+  if (!buffer) return nullptr;
+  buffer->variable = new Ipc::PVariable(input);
+  PyObject *memoryView = PyMemoryView_FromObject((PyObject *)buffer);
+  Py_DECREF(buffer); //The memoryview holds its own reference.
+  return memoryView;
+}
+
+Ipc::PVariable PythonVariableConverter::getVariable(PyObject *value, Metrics::Counter *byteCounter) {
   if (!value) return std::make_shared<Ipc::Variable>();
 
-  if (PyTuple_Check(value)) {
-    variable = std::make_shared<Ipc::Variable>(Ipc::VariableType::tArray);
-    Py_ssize_t tupleSize = PyTuple_Size(value);
-    variable->arrayValue->reserve(tupleSize);
-    for (int32_t i = 0; i < tupleSize; i++) {
-      auto arrayElement = getVariable(PyTuple_GetItem(value, i));
-      if (arrayElement) variable->arrayValue->emplace_back(arrayElement);
+  //Scalars are checked first as they are by far the most common values. Strings and binary data are written directly into the new Variable to avoid
+  //temporary copies. No Python code is executed during the conversion, so list items can be accessed without further checks.
+  if (PyUnicode_Check(value)) {
+    auto variable = std::make_shared<Ipc::Variable>(Ipc::VariableType::tString);
+    Py_ssize_t stringSize = 0;
+    const char *utf8String = PyUnicode_AsUTF8AndSize(value, &stringSize); //From the documentation: "The caller is not responsible for deallocating the buffer."
+    if (utf8String) {
+      variable->stringValue.assign(utf8String, stringSize);
+      if (byteCounter) byteCounter->add(stringSize);
     }
-  } else if (PyList_Check(value)) {
-    variable = std::make_shared<Ipc::Variable>(Ipc::VariableType::tArray);
-    Py_ssize_t listSize = PyList_Size(value);
-    variable->arrayValue->reserve(listSize);
-    for (int32_t i = 0; i < listSize; i++) {
-      auto arrayElement = getVariable(PyList_GetItem(value, i));
-      if (arrayElement) variable->arrayValue->emplace_back(arrayElement);
+    else PyErr_Clear();
+    return variable;
+  } else if (PyBool_Check(value)) return std::make_shared<Ipc::Variable>(value == Py_True);
+  else if (PyLong_Check(value)) {
+    int overflow = 0;
+    long long integerValue = PyLong_AsLongLongAndOverflow(value, &overflow);
+    if (!overflow) return std::make_shared<Ipc::Variable>((int64_t)integerValue);
+    //Homegear has no larger integer type, so integers outside of the 64 bit range are passed as float.
+    double floatValue = PyLong_AsDouble(value);
+    if (floatValue == -1.0 && PyErr_Occurred()) {
+      PyErr_Clear();
+      return std::make_shared<Ipc::Variable>();
     }
-  } else if (PyDict_Check(value)) {
-    variable = std::make_shared<Ipc::Variable>(Ipc::VariableType::tStruct);
+    return std::make_shared<Ipc::Variable>(floatValue);
+  }
+  else if (PyFloat_Check(value)) return std::make_shared<Ipc::Variable>(PyFloat_AS_DOUBLE(value));
+  else if (value == Py_None) return std::make_shared<Ipc::Variable>(Ipc::VariableType::tVoid);
+  else if (PyDict_Check(value)) {
+    auto variable = std::make_shared<Ipc::Variable>(Ipc::VariableType::tStruct);
     PyObject *key = nullptr;
     PyObject *dictElement = nullptr;
     Py_ssize_t pos = 0;
     while (PyDict_Next(value, &pos, &key, &dictElement)) {
       if (!key || !dictElement) continue;
-      auto structKey = getVariable(key);
-      auto structElement = getVariable(dictElement);
-      if (structKey && structElement) variable->structValue->emplace(structKey->toString(), structElement);
+      if (PyUnicode_Check(key)) {
+        Py_ssize_t keySize = 0;
+        const char *utf8Key = PyUnicode_AsUTF8AndSize(key, &keySize);
+        if (!utf8Key) {
+          PyErr_Clear();
+          continue;
+        }
+        auto structElement = getVariable(dictElement, byteCounter);
+        if (structElement) variable->structValue->emplace(std::string(utf8Key, keySize), std::move(structElement));
+      } else {
+        auto structKey = getVariable(key, byteCounter);
+        auto structElement = getVariable(dictElement, byteCounter);
+        if (structKey && structElement) variable->structValue->emplace(structKey->toString(), std::move(structElement));
+      }
     }
-  } else if (PyBool_Check(value)) variable = std::make_shared<Ipc::Variable>((bool)PyObject_IsTrue(value));
-  else if (PyLong_Check(value)) variable = std::make_shared<Ipc::Variable>((int64_t)PyLong_AsLongLong(value));
-  else if (PyFloat_Check(value)) variable = std::make_shared<Ipc::Variable>(PyFloat_AsDouble(value));
-  else if (PyUnicode_Check(value)) {
-    Py_ssize_t stringSize = 0;
-    const char *utf8String = PyUnicode_AsUTF8AndSize(value, &stringSize); //From the documentation: "The caller is not responsible for deallocating the buffer."
-    if (utf8String) variable = std::make_shared<Ipc::Variable>(std::string(utf8String, stringSize));
-    else variable = std::make_shared<Ipc::Variable>(Ipc::VariableType::tString);
+    return variable;
+  } else if (PyList_Check(value) || PyTuple_Check(value)) {
+    auto variable = std::make_shared<Ipc::Variable>(Ipc::VariableType::tArray);
+    Py_ssize_t size = PySequence_Fast_GET_SIZE(value);
+    PyObject **items = PySequence_Fast_ITEMS(value);
+    variable->arrayValue->reserve(size);
+    for (Py_ssize_t i = 0; i < size; i++) {
+      auto arrayElement = getVariable(items[i], byteCounter);
+      if (arrayElement) variable->arrayValue->emplace_back(std::move(arrayElement));
+    }
+    return variable;
   } else if (PyBytes_Check(value)) {
-    char *rawByteArray = PyBytes_AsString(value);
-    std::vector<char> byteArray;
-    if (rawByteArray) byteArray = std::vector<char>(rawByteArray, rawByteArray + PyBytes_Size(value));
-    variable = std::make_shared<Ipc::Variable>(byteArray);
+    auto variable = std::make_shared<Ipc::Variable>(Ipc::VariableType::tBinary);
+    char *rawByteArray = PyBytes_AS_STRING(value);
+    variable->binaryValue.assign(rawByteArray, rawByteArray + PyBytes_GET_SIZE(value));
+    if (byteCounter) byteCounter->add(variable->binaryValue.size());
+    return variable;
   } else if (PyByteArray_Check(value)) {
-    char *rawByteArray = PyByteArray_AsString(value);
-    std::vector<char> byteArray;
-    if (rawByteArray) byteArray = std::vector<char>(rawByteArray, rawByteArray + PyByteArray_Size(value));
-    variable = std::make_shared<Ipc::Variable>(byteArray);
-  } else if (value == Py_None) {
-    variable = std::make_shared<Ipc::Variable>(Ipc::VariableType::tVoid);
-  } else {
-    variable = std::make_shared<Ipc::Variable>();
+    auto variable = std::make_shared<Ipc::Variable>(Ipc::VariableType::tBinary);
+    char *rawByteArray = PyByteArray_AS_STRING(value);
+    variable->binaryValue.assign(rawByteArray, rawByteArray + PyByteArray_GET_SIZE(value));
+    if (byteCounter) byteCounter->add(variable->binaryValue.size());
+    return variable;
+  } else if (PyObject_CheckBuffer(value)) {
+    Py_buffer view;
+    if (PyObject_GetBuffer(value, &view, PyBUF_FULL_RO) == -1) {
+      PyErr_Clear();
+      return std::make_shared<Ipc::Variable>();
+    }
+    auto variable = std::make_shared<Ipc::Variable>(Ipc::VariableType::tBinary);
+    if (PyBuffer_IsContiguous(&view, 'C')) {
+      variable->binaryValue.assign((char *)view.buf, (char *)view.buf + view.len);
+    } else {
+      variable->binaryValue.resize(view.len);
+      if (PyBuffer_ToContiguous(variable->binaryValue.data(), &view, view.len, 'C') == -1) {
+        PyErr_Clear();
+        variable->binaryValue.clear();
+      }
+    }
+    PyBuffer_Release(&view);
+    if (byteCounter) byteCounter->add(variable->binaryValue.size());
+    return variable;
   }
 
-  return variable;
+  return std::make_shared<Ipc::Variable>();
+}
+
+Ipc::PArray PythonVariableConverter::getArray(PyObject *const *values, size_t count, Metrics::Counter *byteCounter, const Ipc::PVariable &firstElement) {
+  auto array = std::make_shared<Ipc::Array>();
+  array->reserve(firstElement ? count + 1 : count);
+  if (firstElement) array->emplace_back(firstElement);
+  for (size_t i = 0; i < count; i++) {
+    auto arrayElement = getVariable(values[i], byteCounter);
+    if (arrayElement) array->emplace_back(arrayElement);
+  }
+  return array;
 }
 
-PyObject *PythonVariableConverter::getPythonVariable(const Ipc::PVariable &input) {
-  PyObject *output = nullptr;
-  if (!input) return output;
+PyObject *PythonVariableConverter::getKey(const std::string &key) {
+  if (key.size() > kMaxCachedKeySize) return PyUnicode_DecodeUTF8(key.data(), key.size(), "replace");
 
-  if (input->type == Ipc::VariableType::tArray) {
-    output = PyList_New(input->arrayValue->size());
-    for (int32_t i = 0; i < (int32_t)input->arrayValue->size(); i++) {
-      auto value = getPythonVariable(input->arrayValue->at(i));
-      if (value == nullptr) continue;
-      PyList_SetItem(output, i, value);
+  {
+#ifdef Py_GIL_DISABLED
+    std::shared_lock<std::shared_mutex> keysGuard(_keysMutex);
+#endif
+    auto keyIterator = _keys.find(key);
+    if (keyIterator != _keys.end()) {
+      Py_INCREF(keyIterator->second);
+      return keyIterator->second;
     }
-  } else if (input->type == Ipc::VariableType::tStruct) {
-    output = PyDict_New();
-    for (auto &element : *input->structValue) {
-      auto key = Py_BuildValue("s", element.first.c_str());
-      if (key == nullptr) continue;
-      auto value = getPythonVariable(element.second);
-      if (value == nullptr) continue;
-      PyDict_SetItem(output, key, value);
+  }
+
+  PyObject *pythonKey = PyUnicode_DecodeUTF8(key.data(), key.size(), "replace");
+  if (!pythonKey) return nullptr;
+  PyUnicode_InternInPlace(&pythonKey);
+#ifdef Py_GIL_DISABLED
+  std::unique_lock<std::shared_mutex> keysGuard(_keysMutex);
+#endif
+  if (_keys.size() < kMaxCachedKeys && _keys.emplace(key, pythonKey).second) Py_INCREF(pythonKey); //Reference held by the cache.
+  return pythonKey;
+}
+
+PyObject *PythonVariableConverter::getPythonVariable(const Ipc::PVariable &input, const std::shared_ptr<Metrics::Counter> &byteCounter, bool binaryAsMemoryView, bool lazyContainers) {
+  if (!input) return nullptr;
+  if (lazyContainers && (input->type == Ipc::VariableType::tStruct || input->type == Ipc::VariableType::tArray)) return getLazyContainer(input, byteCounter, binaryAsMemoryView);
+
+  switch (input->type) {
+    case Ipc::VariableType::tArray: {
+      auto &array = *input->arrayValue;
+      PyObject *output = PyList_New(array.size());
+      if (!output) return nullptr;
+      for (size_t i = 0; i < array.size(); i++) {
+        PyObject *value = getPythonVariable(array[i], byteCounter, binaryAsMemoryView);
+        if (!value) {
+          Py_DECREF(output);
+          return nullptr;
+        }
+        PyList_SET_ITEM(output, i, value); //Steals the reference.
+      }
+      return output;
     }
-  } else if (input->type == Ipc::VariableType::tVoid) {
-    Py_INCREF(Py_None);
-    output = Py_None;
-  } else if (input->type == Ipc::VariableType::tBoolean) {
-    if (input->booleanValue) {
-      Py_INCREF(Py_True);
-      output = Py_True;
-    } else {
-      Py_INCREF(Py_False);
-      output = Py_False;
+    case Ipc::VariableType::tStruct: {
+      PyObject *output = PyDict_New();
+      if (!output) return nullptr;
+      for (auto &element : *input->structValue) {
+        PyObject *key = getKey(element.first);
+        PyObject *value = key ? getPythonVariable(element.second, byteCounter, binaryAsMemoryView) : nullptr;
+        if (!value || PyDict_SetItem(output, key, value) == -1) {
+          Py_XDECREF(key);
+          Py_XDECREF(value);
+          Py_DECREF(output);
+          return nullptr;
+        }
+        Py_DECREF(key);
+        Py_DECREF(value);
+      }
+      return output;
     }
-  } else if (input->type == Ipc::VariableType::tInteger) {
-    output = Py_BuildValue("l", (long)input->integerValue);
-  } else if (input->type == Ipc::VariableType::tInteger64) {
-    output = Py_BuildValue("L", (long long)input->integerValue64);
-  } else if (input->type == Ipc::VariableType::tFloat) {
-    output = Py_BuildValue("d", input->floatValue);
-  } else if (input->type == Ipc::VariableType::tString || input->type == Ipc::VariableType::tBase64) {
-    output = Py_BuildValue("s", input->stringValue.c_str());
-  } else if (input->type == Ipc::VariableType::tBinary) {
-    output = Py_BuildValue("y", (char *)input->binaryValue.data());
-  } else {
-    output = Py_BuildValue("s", "UNKNOWN");
-  }
-  return output;
+    case Ipc::VariableType::tVoid:
+      Py_RETURN_NONE;
+    case Ipc::VariableType::tBoolean:
+      if (input->booleanValue) Py_RETURN_TRUE;
+      else Py_RETURN_FALSE;
+    case Ipc::VariableType::tInteger:
+      return PyLong_FromLong((long)input->integerValue);
+    case Ipc::VariableType::tInteger64:
+      return PyLong_FromLongLong((long long)input->integerValue64);
+    case Ipc::VariableType::tFloat:
+      return PyFloat_FromDouble(input->floatValue);
+    case Ipc::VariableType::tString:
+    case Ipc::VariableType::tBase64:
+      if (byteCounter) byteCounter->add(input->stringValue.size());
+      return PyUnicode_DecodeUTF8(input->stringValue.data(), input->stringValue.size(), "replace");
+    case Ipc::VariableType::tBinary:
+      if (byteCounter) byteCounter->add(input->binaryValue.size());
+      if (binaryAsMemoryView) return getBinaryMemoryView(input);
+      return PyBytes_FromStringAndSize(input->binaryValue.data(), input->binaryValue.size());
+    default:
+      return PyUnicode_FromString("UNKNOWN");
+  }
 }
-
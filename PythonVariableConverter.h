@@ -31,15 +31,113 @@
 #ifndef PYTHONVARIABLECONVERTER_H_
 #define PYTHONVARIABLECONVERTER_H_
 
+#include "Metrics.h"
+
 #include <homegear-ipc/Variable.h>
 #include <Python.h>
+#include <array>
+#include <shared_mutex>
+#include <unordered_map>
 
+/**
+ * Converts between Python objects and Homegear variables. Python objects can't be shared between interpreters, so the conversion to Python uses an
+ * object per interpreter holding the key cache and the buffer and proxy types. It is part of the module state. The conversion to Homegear variables is static.
+ */
 class PythonVariableConverter {
  public:
-  PythonVariableConverter() = delete;
+  enum class MappingView : int32_t {
+    kKeys,
+    kValues,
+    kItems
+  };
+
+  PythonVariableConverter() = default;
+  PythonVariableConverter(const PythonVariableConverter &) = delete;
+  PythonVariableConverter &operator=(const PythonVariableConverter &) = delete;
+
+  /**
+   * Releases the cached keys. The GIL of the interpreter the object was used in must be held.
+   */
+  ~PythonVariableConverter();
+
+  /**
+   * Must be called once before the object is used.
+   *
+   * @param owner Optional. The object owning the converter, e. g. the module. Lazy containers hold a reference to it, so the converter is not destroyed
+   * while they are alive.
+   * @return 0 on success, -1 with a Python exception set on error.
+   */
+  int init(PyObject *owner = nullptr);
+
+  /**
+   * Converts a Python object. Besides bytes and bytearray, all objects supporting the buffer protocol (memoryview, array.array, numpy arrays, ...) are
+   * converted to binary. Their data is copied once into the Variable.
+   *
+   * @param byteCounter Optional. Counts the string and binary bytes converted.
+   */
+  static Ipc::PVariable getVariable(PyObject *value, Metrics::Counter *byteCounter);
+
+  /**
+   * Converts "count" Python objects to an array without wrapping them in a tuple first.
+   *
+   * @param values Pointer to the first object, e. g. the argument vector of a vectorcall.
+   * @param count The number of objects.
+   * @param byteCounter Optional. Counts the string and binary bytes converted.
+   * @param firstElement When set, this element is inserted before the converted objects.
+   */
+  static Ipc::PArray getArray(PyObject *const *values, size_t count, Metrics::Counter *byteCounter, const Ipc::PVariable &firstElement = Ipc::PVariable());
+  /**
+   * Converts a Variable to a Python object.
+   *
+   * @param byteCounter Optional. Counts the string and binary bytes converted. Lazy containers keep it to count their elements converted later.
+   * @param binaryAsMemoryView When true, binary values are returned as read-only memoryview objects referencing the data of the Variable instead of
+   * copying it into a bytes object.
+   * @param lazyContainers When true, structs and arrays are returned as read-only HomegearStruct and HomegearArray proxies referencing the Variable.
+   * Their elements are converted on first access.
+   */
+  PyObject *getPythonVariable(const Ipc::PVariable &input, const std::shared_ptr<Metrics::Counter> &byteCounter, bool binaryAsMemoryView = false, bool lazyContainers = false);
+
+  /**
+   * Returns a new reference to a Python string for a struct key, variable name or event source. Short keys are cached, so repeated keys like
+   * "faultCode", "TYPE" or parameter names are only created once and share one object. The GIL must be held.
+   */
+  PyObject *getKey(const std::string &key);
+
+  /**
+   * Returns a read-only memoryview exporting "data" as a one-dimensional array through the buffer protocol, e. g. for numpy.asarray(). The data is
+   * moved into the buffer object and not copied again.
+   *
+   * @param format The struct module format of one item, e. g. "d" or "q".
+   * @param itemSize The size of one item in bytes. The size of data must be a multiple of it.
+   */
+  PyObject *getColumn(std::vector<char> &&data, const char *format, Py_ssize_t itemSize);
+
+  /**
+   * Returns a collections.abc KeysView, ValuesView or ItemsView of a HomegearStruct, like dict.keys(), dict.values() and dict.items() do.
+   */
+  PyObject *getMappingView(PyObject *lazyStruct, MappingView view);
+
+  /**
+   * Returns an iterator over the elements of a HomegearArray in reverse order. Elements are converted when the iterator reaches them.
+   */
+  PyObject *getReverseIterator(PyObject *lazyArray);
+
+ private:
+  static const size_t kMaxCachedKeys = 4096;
+  static const size_t kMaxCachedKeySize = 64;
+
+  std::shared_mutex _keysMutex; //Only used in free-threaded builds, otherwise the GIL protects _keys
+  std::unordered_map<std::string, PyObject *> _keys;
+  PyObject *_binaryBufferType = nullptr;
+  PyObject *_columnType = nullptr;
+  PyObject *_lazyStructType = nullptr;
+  PyObject *_lazyArrayType = nullptr;
+  PyObject *_reverseIteratorType = nullptr;
+  std::array<PyObject *, 3> _mappingViewTypes{}; //collections.abc.KeysView, ValuesView and ItemsView by MappingView
+  PyObject *_owner = nullptr; //Borrowed, the owner outlives the converter
 
-  static Ipc::PVariable getVariable(PyObject *value);
-  static PyObject *getPythonVariable(const Ipc::PVariable &input);
+  PyObject *getBinaryMemoryView(const Ipc::PVariable &input);
+  PyObject *getLazyContainer(const Ipc::PVariable &input, const std::shared_ptr<Metrics::Counter> &byteCounter, bool binaryAsMemoryView);
 };
 
 #endif
\ No newline at end of file
@@ -0,0 +1,203 @@
+/* Copyright 2013-2019 Homegear GmbH
+ *
+ * Homegear is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * Homegear is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with Homegear.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ *
+ * In addition, as a special exception, the copyright holders give
+ * permission to link the code of portions of this program with the
+ * OpenSSL library under certain conditions as described in each
+ * individual source file, and distribute linked combinations
+ * including the two.
+ * You must obey the GNU Lesser General Public License in all respects
+ * for all of the code used other than OpenSSL.  If you modify
+ * file(s) with this exception, you may extend this exception to your
+ * version of the file(s), but you are not obligated to do so.  If you
+ * do not wish to do so, delete this exception statement from your
+ * version.  If you delete this exception statement from all source
+ * files in the program, then also delete it here.
+*/
+
+#include "ValueCache.h"
+
+ValueCache::ValueCache(size_t capacity) : _capacity(capacity) {
+  _entries.reserve(capacity);
+}
+
+bool ValueCache::isReadMethod(const std::string &methodName) {
+  return methodName == "getValue" || methodName == "getSystemVariable" || methodName == "getMetadata";
+}
+
+bool ValueCache::isWriteMethod(const std::string &methodName) {
+  return methodName == "setValue" || methodName == "setSystemVariable" || methodName == "deleteSystemVariable" || methodName == "setMetadata" || methodName == "deleteMetadata" || methodName == "deleteDevice" || methodName == "putParamset";
+}
+
+bool ValueCache::getReadKey(const std::string &methodName, const Ipc::PArray &parameters, Key &key) {
+  if (methodName == "getValue") {
+    //Reads with requestFromDevice set always go to Homegear.
+    if (parameters->size() < 3 || parameters->size() > 5 || (parameters->size() >= 4 && parameters->at(3)->booleanValue)) return false;
+    key.peerId = (uint64_t)parameters->at(0)->integerValue64;
+    key.channel = parameters->at(1)->integerValue;
+    key.name = parameters->at(2)->stringValue;
+    return true;
+  } else if (methodName == "getSystemVariable") {
+    if (parameters->size() != 1) return false;
+    key.peerId = 0;
+    key.channel = -1;
+    key.name = parameters->at(0)->stringValue;
+    return true;
+  } else if (methodName == "getMetadata") {
+    if (parameters->size() != 2) return false;
+    key.peerId = (uint64_t)parameters->at(0)->integerValue64;
+    key.channel = -1;
+    key.name = parameters->at(1)->stringValue;
+    return true;
+  }
+  return false;
+}
+
+bool ValueCache::getWriteKey(const std::string &methodName, const Ipc::PArray &parameters, Key &key, bool &clearAll) {
+  clearAll = false;
+  if (methodName == "setValue") {
+    if (parameters->size() < 3) return false;
+    key.peerId = (uint64_t)parameters->at(0)->integerValue64;
+    key.channel = parameters->at(1)->integerValue;
+    key.name = parameters->at(2)->stringValue;
+    return true;
+  } else if (methodName == "setSystemVariable" || methodName == "deleteSystemVariable") {
+    if (parameters->empty()) return false;
+    key.peerId = 0;
+    key.channel = -1;
+    key.name = parameters->at(0)->stringValue;
+    return true;
+  } else if (methodName == "setMetadata" || methodName == "deleteMetadata") {
+    if (parameters->empty()) return false;
+    key.peerId = (uint64_t)parameters->at(0)->integerValue64;
+    key.channel = -1;
+    if (parameters->size() >= 2) key.name = parameters->at(1)->stringValue;
+    else clearAll = true; //deleteMetadata without data ID deletes all metadata of the peer.
+    return true;
+  } else if (methodName == "deleteDevice" || methodName == "putParamset") {
+    clearAll = true;
+    return true;
+  }
+  return false;
+}
+
+size_t ValueCache::size() {
+  std::lock_guard<std::mutex> entriesGuard(_mutex);
+  return _valueCount;
+}
+
+bool ValueCache::get(const Key &key, Ipc::PVariable &value, uint64_t &token) {
+  std::lock_guard<std::mutex> entriesGuard(_mutex);
+  auto entryIterator = _entries.find(key);
+  if (entryIterator != _entries.end() && entryIterator->second.value) {
+    value = entryIterator->second.value;
+    _lru.splice(_lru.begin(), _lru, entryIterator->second.lruPosition);
+    _hitCount++;
+    return true;
+  }
+
+  _missCount++;
+  if (entryIterator == _entries.end()) {
+    if (_entries.size() >= _capacity && !evict()) {
+      token = 0; //All entries are being read, the value is not stored.
+      return false;
+    }
+    entryIterator = _entries.emplace(key, Entry()).first;
+    entryIterator->second.version = ++_currentVersion;
+    _lru.push_front(&entryIterator->first);
+    entryIterator->second.lruPosition = _lru.begin();
+  }
+  entryIterator->second.pendingReads++;
+  token = entryIterator->second.version;
+  return false;
+}
+
+void ValueCache::set(const Key &key, uint64_t token, const Ipc::PVariable &value) {
+  if (token == 0) return;
+  std::lock_guard<std::mutex> entriesGuard(_mutex);
+  auto entryIterator = _entries.find(key);
+  if (entryIterator == _entries.end()) return;
+  auto &entry = entryIterator->second;
+  if (entry.pendingReads > 0) entry.pendingReads--;
+  if (entry.version == token && !entry.value && value && !value->errorStruct && value->type != Ipc::VariableType::tVoid) {
+    entry.value = value;
+    _valueCount++;
+  } else if (!entry.value && entry.pendingReads == 0) {
+    erase(entryIterator);
+  }
+}
+
+void ValueCache::update(uint64_t peerId, int32_t channel, const Ipc::PArray &variableNames, const Ipc::PArray &values) {
+  Key key;
+  key.peerId = peerId;
+  key.channel = channel;
+  std::lock_guard<std::mutex> entriesGuard(_mutex);
+  if (_entries.empty()) return;
+  for (size_t i = 0; i < variableNames->size() && i < values->size(); i++) {
+    key.name = variableNames->at(i)->stringValue;
+    auto entryIterator = _entries.find(key);
+    if (entryIterator == _entries.end()) continue;
+    auto &entry = entryIterator->second;
+    if (!entry.value) _valueCount++;
+    entry.value = values->at(i);
+    entry.version = ++_currentVersion;
+  }
+}
+
+void ValueCache::invalidate(const Key &key) {
+  std::lock_guard<std::mutex> entriesGuard(_mutex);
+  auto entryIterator = _entries.find(key);
+  if (entryIterator == _entries.end()) return;
+  auto &entry = entryIterator->second;
+  if (entry.value) _valueCount--;
+  if (entry.pendingReads == 0) {
+    erase(entryIterator);
+    return;
+  }
+  entry.value.reset();
+  entry.version = ++_currentVersion;
+}
+
+void ValueCache::clear() {
+  std::lock_guard<std::mutex> entriesGuard(_mutex);
+  for (auto entryIterator = _entries.begin(); entryIterator != _entries.end();) {
+    auto &entry = entryIterator->second;
+    if (entry.pendingReads == 0) {
+      entryIterator = erase(entryIterator);
+      continue;
+    }
+    entry.value.reset();
+    entry.version = ++_currentVersion;
+    ++entryIterator;
+  }
+  _valueCount = 0;
+}
+
+bool ValueCache::evict() {
+  for (auto lruIterator = _lru.rbegin(); lruIterator != _lru.rend(); ++lruIterator) {
+    auto entryIterator = _entries.find(**lruIterator);
+    if (entryIterator->second.pendingReads > 0) continue;
+    if (entryIterator->second.value) _valueCount--;
+    erase(entryIterator);
+    return true;
+  }
+  return false;
+}
+
+ValueCache::EntryIterator ValueCache::erase(EntryIterator entryIterator) {
+  _lru.erase(entryIterator->second.lruPosition);
+  return _entries.erase(entryIterator);
+}
@@ -0,0 +1,136 @@
+/* Copyright 2013-2019 Homegear GmbH
+ *
+ * Homegear is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * Homegear is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with Homegear.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ *
+ * In addition, as a special exception, the copyright holders give
+ * permission to link the code of portions of this program with the
+ * OpenSSL library under certain conditions as described in each
+ * individual source file, and distribute linked combinations
+ * including the two.
+ * You must obey the GNU Lesser General Public License in all respects
+ * for all of the code used other than OpenSSL.  If you modify
+ * file(s) with this exception, you may extend this exception to your
+ * version of the file(s), but you are not obligated to do so.  If you
+ * do not wish to do so, delete this exception statement from your
+ * version.  If you delete this exception statement from all source
+ * files in the program, then also delete it here.
+*/
+
+#ifndef VALUECACHE_H_
+#define VALUECACHE_H_
+
+#include <homegear-ipc/IIpcClient.h>
+
+#include <atomic>
+#include <list>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+/**
+ * Read-through cache for getValue, getSystemVariable and getMetadata. Cached values are updated by broadcastEvent, so they stay coherent as long as
+ * the connection is up. The cache is cleared on every (re)connect. When it is full, the least recently used value is evicted.
+ *
+ * System variables are stored with peer ID 0 and channel -1, metadata with the peer ID and channel -1. This is how Homegear sends them in broadcastEvent.
+ */
+class ValueCache {
+ public:
+  struct Key {
+    uint64_t peerId = 0;
+    int32_t channel = -1;
+    std::string name;
+
+    bool operator==(const Key &other) const { return peerId == other.peerId && channel == other.channel && name == other.name; }
+  };
+
+  explicit ValueCache(size_t capacity);
+  ~ValueCache() = default;
+
+  static bool isReadMethod(const std::string &methodName);
+  static bool isWriteMethod(const std::string &methodName);
+
+  /**
+   * Returns true when the result of the RPC call can be cached and sets key.
+   */
+  static bool getReadKey(const std::string &methodName, const Ipc::PArray &parameters, Key &key);
+
+  /**
+   * Returns true when the RPC call changes a cacheable value and sets key. clearAll is set when the call can change any number of values.
+   */
+  static bool getWriteKey(const std::string &methodName, const Ipc::PArray &parameters, Key &key, bool &clearAll);
+
+  size_t capacity() const { return _capacity; }
+  size_t size();
+  uint64_t hitCount() const { return _hitCount; }
+  uint64_t missCount() const { return _missCount; }
+
+  /**
+   * Returns true and sets value on a hit. On a miss, the read is registered and token must be passed to set() once the value was read from Homegear.
+   */
+  bool get(const Key &key, Ipc::PVariable &value, uint64_t &token);
+
+  /**
+   * Stores the result of a read registered by get(). The value is discarded when the key was updated or invalidated in the meantime. Must be called for
+   * every miss, also when the call failed (value is nullptr then).
+   */
+  void set(const Key &key, uint64_t token, const Ipc::PVariable &value);
+
+  /**
+   * Updates already cached values with the variables of one broadcastEvent.
+   */
+  void update(uint64_t peerId, int32_t channel, const Ipc::PArray &variableNames, const Ipc::PArray &values);
+
+  void invalidate(const Key &key);
+  void clear();
+ private:
+  struct KeyHash {
+    size_t operator()(const Key &key) const {
+      size_t hash = std::hash<std::string>()(key.name);
+      hash ^= std::hash<uint64_t>()(key.peerId) + 0x9e3779b97f4a7c15ull + (hash << 6) + (hash >> 2);
+      hash ^= std::hash<int32_t>()(key.channel) + 0x9e3779b97f4a7c15ull + (hash << 6) + (hash >> 2);
+      return hash;
+    }
+  };
+
+  struct Entry {
+    Ipc::PVariable value; //nullptr while the value is not known
+    uint64_t version = 0; //Changed on every update and invalidation, so results of reads started before are discarded.
+    uint32_t pendingReads = 0;
+    std::list<const Key *>::iterator lruPosition;
+  };
+
+  typedef std::unordered_map<Key, Entry, KeyHash>::iterator EntryIterator;
+
+  size_t _capacity = 0;
+  std::mutex _mutex;
+  uint64_t _currentVersion = 0;
+  std::unordered_map<Key, Entry, KeyHash> _entries;
+  std::list<const Key *> _lru; //Keys of _entries, most recently used first
+  size_t _valueCount = 0;
+  std::atomic<uint64_t> _hitCount{0};
+  std::atomic<uint64_t> _missCount{0};
+
+  /**
+   * Evicts the least recently used entry without pending reads. Returns false when every entry has pending reads. _mutex must be locked.
+   */
+  bool evict();
+
+  /**
+   * Removes an entry. _mutex must be locked.
+   */
+  EntryIterator erase(EntryIterator entryIterator);
+};
+
+#endif
@@ -0,0 +1,196 @@
+/* Copyright 2013-2019 Homegear GmbH
+ *
+ * Homegear is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * Homegear is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with Homegear.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ *
+ * In addition, as a special exception, the copyright holders give
+ * permission to link the code of portions of this program with the
+ * OpenSSL library under certain conditions as described in each
+ * individual source file, and distribute linked combinations
+ * including the two.
+ * You must obey the GNU Lesser General Public License in all respects
+ * for all of the code used other than OpenSSL.  If you modify
+ * file(s) with this exception, you may extend this exception to your
+ * version of the file(s), but you are not obligated to do so.  If you
+ * do not wish to do so, delete this exception statement from your
+ * version.  If you delete this exception statement from all source
+ * files in the program, then also delete it here.
+*/
+
+#include "WriteBuffer.h"
+
+WriteBuffer::WriteBuffer(IpcClientPool *ipcClientPool, std::chrono::steady_clock::duration interval, std::function<void(std::vector<Write> &writes, const Ipc::PVariable &result)> resultHandler, Metrics::MethodStats *stats)
+    : _ipcClientPool(ipcClientPool), _interval(interval), _resultHandler(std::move(resultHandler)), _stats(stats) {
+  _thread = std::thread(&WriteBuffer::work, this);
+}
+
+WriteBuffer::~WriteBuffer() {
+  {
+    std::lock_guard<std::mutex> guard(_mutex);
+    _stopped = true;
+  }
+  _conditionVariable.notify_all();
+  _sentConditionVariable.notify_all();
+  if (_thread.joinable()) _thread.join();
+}
+
+bool WriteBuffer::isWriteMethod(const std::string &methodName) {
+  return methodName == "setValue" || methodName == "setSystemVariable" || methodName == "setMetadata";
+}
+
+static size_t getKeySize(const std::string &methodName) {
+  if (methodName == "setValue") return 3;
+  else if (methodName == "setSystemVariable") return 1;
+  else if (methodName == "setMetadata") return 2;
+  return 0;
+}
+
+bool WriteBuffer::getKey(const std::string &methodName, const Ipc::PArray &parameters, std::string &key) {
+  //The key consists of all parameters before the value.
+  size_t keySize = getKeySize(methodName);
+  if (keySize == 0 || parameters->size() != keySize + 1) return false;
+  return getKey(methodName, parameters, keySize, key);
+}
+
+bool WriteBuffer::getAffectedKey(const std::string &methodName, const Ipc::PArray &parameters, std::string &key) {
+  size_t keySize = getKeySize(methodName);
+  if (keySize == 0 || parameters->size() < keySize) return false;
+  return getKey(methodName, parameters, keySize, key);
+}
+
+bool WriteBuffer::getKey(const std::string &methodName, const Ipc::PArray &parameters, size_t keySize, std::string &key) {
+  key = methodName;
+  for (size_t i = 0; i < keySize; i++) {
+    auto &parameter = parameters->at(i);
+    key.push_back('\n');
+    if (parameter->type == Ipc::VariableType::tString) key.append(parameter->stringValue);
+    else if (parameter->type == Ipc::VariableType::tInteger || parameter->type == Ipc::VariableType::tInteger64) key.append(std::to_string(parameter->integerValue64));
+    else return false;
+  }
+  return true;
+}
+
+size_t WriteBuffer::size() {
+  std::lock_guard<std::mutex> guard(_mutex);
+  return _writes.size();
+}
+
+bool WriteBuffer::push(const std::string &methodName, const Ipc::PArray &parameters) {
+  std::lock_guard<std::mutex> guard(_mutex);
+  if (_stopped) return false;
+  _pushSequence++;
+  if (append(Write{methodName, parameters})) _coalescedCount++;
+  return true;
+}
+
+bool WriteBuffer::append(Write &&write) {
+  std::string key;
+  if (getKey(write.methodName, write.parameters, key)) {
+    auto positionIterator = _positions.find(key);
+    if (positionIterator != _positions.end()) {
+      _writes[positionIterator->second].parameters = std::move(write.parameters);
+      return true;
+    }
+    _positions.emplace(std::move(key), _writes.size());
+  } else {
+    //Later writes to the same key must not be coalesced with a write queued before this one, otherwise this write would overwrite them.
+    if (getAffectedKey(write.methodName, write.parameters, key)) _positions.erase(key);
+    else _positions.clear();
+  }
+  _writes.emplace_back(std::move(write));
+  return false;
+}
+
+void WriteBuffer::requeue(std::vector<Write> &writes) {
+  std::lock_guard<std::mutex> guard(_mutex);
+  std::vector<Write> newerWrites;
+  newerWrites.swap(_writes);
+  _positions.clear();
+  for (auto &write : writes) {
+    append(std::move(write));
+  }
+  for (auto &write : newerWrites) {
+    append(std::move(write));
+  }
+}
+
+bool WriteBuffer::flush() {
+  if (!_ipcClientPool->connected()) return false;
+  std::unique_lock<std::mutex> lock(_mutex);
+  uint64_t sequence = _pushSequence;
+  if (_sentSequence >= sequence) return true;
+  _flushRequested = true;
+  _conditionVariable.notify_all();
+  _sentConditionVariable.wait(lock, [&] { return _stopped || _sentSequence >= sequence || !_ipcClientPool->connected(); });
+  return _sentSequence >= sequence;
+}
+
+void WriteBuffer::sendWrites() {
+  std::vector<Write> writes;
+  uint64_t sequence = 0;
+  {
+    std::unique_lock<std::mutex> lock(_mutex);
+    _flushRequested = false;
+    if (!_ipcClientPool->connected()) {
+      //The writes stay queued until the connection is back. Threads waiting in flush() return false.
+      lock.unlock();
+      _sentConditionVariable.notify_all();
+      return;
+    }
+    writes.swap(_writes);
+    _positions.clear();
+    sequence = _pushSequence;
+  }
+
+  if (!writes.empty()) {
+    auto callArray = std::make_shared<Ipc::Variable>(Ipc::VariableType::tArray);
+    callArray->arrayValue->reserve(writes.size());
+    for (auto &write : writes) {
+      auto callStruct = std::make_shared<Ipc::Variable>(Ipc::VariableType::tStruct);
+      callStruct->structValue->emplace("methodName", std::make_shared<Ipc::Variable>(write.methodName));
+      callStruct->structValue->emplace("params", std::make_shared<Ipc::Variable>(write.parameters));
+      callArray->arrayValue->emplace_back(std::move(callStruct));
+    }
+    auto parameters = std::make_shared<Ipc::Array>();
+    parameters->emplace_back(std::move(callArray));
+
+    auto result = _ipcClientPool->invoke("system.multicall", parameters, _stats);
+    if (result->errorStruct && !_ipcClientPool->connected()) {
+      //The connection was lost while sending. The writes are sent again after reconnecting and threads waiting in flush() return false.
+      requeue(writes);
+      _sentConditionVariable.notify_all();
+      return;
+    }
+    _sentCount += writes.size();
+    if (_resultHandler) _resultHandler(writes, result);
+  }
+
+  {
+    std::lock_guard<std::mutex> guard(_mutex);
+    _sentSequence = sequence;
+  }
+  _sentConditionVariable.notify_all();
+}
+
+void WriteBuffer::work() {
+  std::unique_lock<std::mutex> lock(_mutex);
+  while (!_stopped) {
+    _conditionVariable.wait_for(lock, _interval, [&] { return _stopped || _flushRequested; });
+    lock.unlock();
+    sendWrites();
+    lock.lock();
+  }
+  lock.unlock();
+  sendWrites(); //Pending writes are not discarded on shutdown.
+}
@@ -0,0 +1,133 @@
+/* Copyright 2013-2019 Homegear GmbH
+ *
+ * Homegear is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * Homegear is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with Homegear.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ *
+ * In addition, as a special exception, the copyright holders give
+ * permission to link the code of portions of this program with the
+ * OpenSSL library under certain conditions as described in each
+ * individual source file, and distribute linked combinations
+ * including the two.
+ * You must obey the GNU Lesser General Public License in all respects
+ * for all of the code used other than OpenSSL.  If you modify
+ * file(s) with this exception, you may extend this exception to your
+ * version of the file(s), but you are not obligated to do so.  If you
+ * do not wish to do so, delete this exception statement from your
+ * version.  If you delete this exception statement from all source
+ * files in the program, then also delete it here.
+*/
+
+#ifndef WRITEBUFFER_H_
+#define WRITEBUFFER_H_
+
+#include "IpcClientPool.h"
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+/**
+ * Write-behind buffer for setValue, setSystemVariable and setMetadata. Writes to the same method and key within one interval are coalesced, only the last
+ * value is sent. A background thread sends all pending writes once per interval as one "system.multicall", so each key is written at most once per
+ * interval.
+ */
+class WriteBuffer {
+ public:
+  struct Write {
+    std::string methodName;
+    Ipc::PArray parameters;
+  };
+
+  /**
+   * @param resultHandler Called by the background thread after each batch with the writes and the result of "system.multicall" (one entry per write or
+   * an error struct when the whole call failed).
+   * @param stats Optional. Records the latency of the batches.
+   */
+  WriteBuffer(IpcClientPool *ipcClientPool, std::chrono::steady_clock::duration interval, std::function<void(std::vector<Write> &writes, const Ipc::PVariable &result)> resultHandler, Metrics::MethodStats *stats = nullptr);
+
+  /**
+   * Sends the pending writes when connected and stops the background thread.
+   */
+  ~WriteBuffer();
+
+  static bool isWriteMethod(const std::string &methodName);
+
+  /**
+   * Sets key to the method name and all parameters before the value. Returns false when the call has no such key, the write can't be coalesced then.
+   */
+  static bool getKey(const std::string &methodName, const Ipc::PArray &parameters, std::string &key);
+
+  /**
+   * For writes getKey() fails for, e. g. setValue with the optional fifth parameter: sets key to the key the write changes. Returns false when it can't
+   * be determined, any key might be changed then.
+   */
+  static bool getAffectedKey(const std::string &methodName, const Ipc::PArray &parameters, std::string &key);
+
+  size_t size();
+  uint64_t coalescedCount() const { return _coalescedCount; }
+  uint64_t sentCount() const { return _sentCount; }
+
+  /**
+   * Queues a write. Writes which can't be coalesced are queued in order, later writes to the same key are queued after them. Returns false when the
+   * buffer was stopped.
+   */
+  bool push(const std::string &methodName, const Ipc::PArray &parameters);
+
+  /**
+   * Sends all writes queued before the call and waits until they were executed. Returns false when there is no connection or the connection was lost
+   * while sending, the writes stay queued then.
+   */
+  bool flush();
+ private:
+  IpcClientPool *_ipcClientPool = nullptr;
+  std::chrono::steady_clock::duration _interval;
+  std::function<void(std::vector<Write> &writes, const Ipc::PVariable &result)> _resultHandler;
+  Metrics::MethodStats *_stats = nullptr;
+
+  std::mutex _mutex;
+  std::condition_variable _conditionVariable; //Wakes up the background thread
+  std::condition_variable _sentConditionVariable; //Wakes up threads waiting in flush()
+  bool _stopped = false;
+  bool _flushRequested = false;
+  std::vector<Write> _writes; //In the order of the first write of each key
+  std::unordered_map<std::string, size_t> _positions; //Key => index in _writes
+  uint64_t _pushSequence = 0; //Incremented by every push()
+  uint64_t _sentSequence = 0; //_pushSequence of the last batch that was executed
+  std::atomic<uint64_t> _coalescedCount{0};
+  std::atomic<uint64_t> _sentCount{0};
+  std::thread _thread;
+
+  static bool getKey(const std::string &methodName, const Ipc::PArray &parameters, size_t keySize, std::string &key);
+
+  /**
+   * Adds a write to _writes, coalescing it with a queued write to the same key. _mutex must be locked.
+   */
+  bool append(Write &&write);
+
+  /**
+   * Puts writes which couldn't be sent back in front of the queue.
+   */
+  void requeue(std::vector<Write> &writes);
+
+  void sendWrites();
+  void work();
+};
+
+#endif
@@ -0,0 +1,195 @@
+#!/usr/bin/env python3
+# Measures the method dispatch overhead, the round trip latency and throughput of RPC calls, the conversion of typical
+# payloads and the event throughput. By default the calls go to stub_server.py, which is started automatically, so no
+# real Homegear is needed. The results are printed as JSON so they can be compared across versions.
+#
+# Usage: benchmark.py [--socket PATH] [--duration SECONDS] [--output FILE]
+
+import argparse
+import json
+import os
+import platform
+import statistics
+import subprocess
+import sys
+import tempfile
+import threading
+import time
+from homegear import Homegear
+
+PAYLOADS = {
+	"scalars": (42, 3.14, True, "temperature", None),
+	"wideStruct": {"PARAMETER_" + str(i): i * 0.5 for i in range(1000)},
+	"deepNesting": None,
+	"largeBinary": bytes(4 << 20)
+}
+
+nested = [1, 2, 3]
+for i in range(50):
+	nested = {"level": i, "values": [1.5, "x"], "child": nested}
+PAYLOADS["deepNesting"] = nested
+
+
+def measure(name, duration, function, **details):
+	"""Calls function until duration seconds have passed and returns the result entry."""
+	iterations = 0
+	latencies = []
+	start = time.perf_counter()
+	end = start + duration
+	now = start
+	while now < end:
+		function()
+		previous = now
+		now = time.perf_counter()
+		latencies.append(now - previous)
+		iterations += 1
+	seconds = now - start
+	result = {"name": name, "iterations": iterations, "seconds": seconds, "operationsPerSecond": iterations / seconds,
+	          "latencyMedianMicroseconds": statistics.median(latencies) * 1e6,
+	          "latencyP99Microseconds": sorted(latencies)[int(len(latencies) * 0.99)] * 1e6}
+	result.update(details)
+	return result
+
+
+def measureLoop(name, duration, function, batchSize, **details):
+	"""Like measure() for very cheap functions. function is called batchSize times per time measurement."""
+	iterations = 0
+	start = time.perf_counter()
+	end = start + duration
+	now = start
+	while now < end:
+		for i in range(batchSize):
+			function()
+		iterations += batchSize
+		now = time.perf_counter()
+	seconds = now - start
+	result = {"name": name, "iterations": iterations, "seconds": seconds, "operationsPerSecond": iterations / seconds,
+	          "nanosecondsPerOperation": seconds / iterations * 1e9}
+	result.update(details)
+	return result
+
+
+def measureThreads(name, duration, threadCount, function, **details):
+	"""Calls function from threadCount threads in parallel."""
+	counts = [0] * threadCount
+	end = time.perf_counter() + duration
+
+	def worker(index):
+		while time.perf_counter() < end:
+			function()
+			counts[index] += 1
+
+	start = time.perf_counter()
+	threads = [threading.Thread(target=worker, args=(i,)) for i in range(threadCount)]
+	for thread in threads:
+		thread.start()
+	for thread in threads:
+		thread.join()
+	seconds = time.perf_counter() - start
+	result = {"name": name, "threads": threadCount, "iterations": sum(counts), "seconds": seconds, "operationsPerSecond": sum(counts) / seconds}
+	result.update(details)
+	return result
+
+
+def runBenchmarks(socketPath, duration):
+	results = []
+	eventCount = [0]
+	eventsDone = threading.Event()
+	expectedEvents = [0]
+
+	def eventHandler(eventSource, peerId, channel, variableName, value):
+		eventCount[0] += 1
+		if eventCount[0] >= expectedEvents[0]:
+			eventsDone.set()
+
+	hg = Homegear(socketPath, eventHandler)
+	if not hg.connected():
+		raise RuntimeError("Could not connect to " + socketPath)
+
+	# Dispatch: attribute lookup and call without any IPC. connected() is answered locally.
+	results.append(measureLoop("dispatch.lookupAndCall", duration, lambda: hg.connected(), 1000))
+	method = hg.connected
+	results.append(measureLoop("dispatch.call", duration, method, 1000))
+
+	# Round trips
+	results.append(measure("roundTrip.echoInteger", duration, lambda: hg.benchmarkEcho(1)))
+	for payloadName, payload in PAYLOADS.items():
+		results.append(measure("roundTrip.echo." + payloadName, duration, lambda: hg.benchmarkEcho(payload)))
+	calls = [("getValue", i, 1, "STATE") for i in range(100)]
+	results.append(measure("roundTrip.multicall100", duration, lambda: hg.multicall(calls), calls=100))
+
+	# Throughput with parallel callers
+	for threadCount in (1, 4, 16):
+		results.append(measureThreads("throughput.echoInteger", duration, threadCount, lambda: hg.benchmarkEcho(1), connections=1))
+	del hg
+
+	pooled = Homegear(socketPath, connections=4)
+	if pooled.connected():
+		for threadCount in (4, 16):
+			results.append(measureThreads("throughput.echoInteger", duration, threadCount, lambda: pooled.benchmarkEcho(1), connections=4))
+	del pooled
+
+	# Events
+	for variableCount, batchEvents in ((1, False), (10, False), (10, True)):
+		eventCount[0] = 0
+		eventsDone.clear()
+		count = 10000
+		expectedEvents[0] = count if batchEvents else count * variableCount
+
+		def batchHandler(eventSource, peerId, channel, variables):
+			eventCount[0] += 1
+			if eventCount[0] >= expectedEvents[0]:
+				eventsDone.set()
+
+		hg = Homegear(socketPath, batchHandler if batchEvents else eventHandler, batchEvents=batchEvents)
+		start = time.perf_counter()
+		hg.benchmarkEvents(count, variableCount)
+		eventsDone.wait(60)
+		seconds = time.perf_counter() - start
+		results.append({"name": "events", "variables": variableCount, "batchEvents": batchEvents, "iterations": eventCount[0], "seconds": seconds,
+		                "operationsPerSecond": eventCount[0] / seconds})
+		del hg
+
+	return results
+
+
+def main():
+	parser = argparse.ArgumentParser(description="Benchmarks for the Homegear Python module.")
+	parser.add_argument("--socket", help="Socket of a running Homegear or stub server. By default stub_server.py is started.")
+	parser.add_argument("--duration", type=float, default=1.0, help="Duration of each benchmark in seconds.")
+	parser.add_argument("--output", help="Write the JSON results to this file instead of stdout.")
+	arguments = parser.parse_args()
+
+	server = None
+	socketPath = arguments.socket
+	if not socketPath:
+		socketPath = os.path.join(tempfile.mkdtemp(), "homegearIPC.sock")
+		server = subprocess.Popen([sys.executable, os.path.join(os.path.dirname(os.path.abspath(__file__)), "stub_server.py"), socketPath])
+		for i in range(100):
+			if os.path.exists(socketPath):
+				break
+			time.sleep(0.05)
+
+	try:
+		results = runBenchmarks(socketPath, arguments.duration)
+	finally:
+		if server:
+			server.terminate()
+			server.wait()
+
+	output = {
+		"python": platform.python_version(),
+		"platform": platform.platform(),
+		"time": time.strftime("%Y-%m-%dT%H:%M:%S%z"),
+		"server": "external" if arguments.socket else "stub",
+		"results": results
+	}
+	if arguments.output:
+		with open(arguments.output, "w") as outputFile:
+			json.dump(output, outputFile, indent=2)
+	else:
+		print(json.dumps(output, indent=2))
+
+
+if __name__ == "__main__":
+	main()
@@ -0,0 +1,40 @@
+#!/usr/bin/env python3
+# Measures the throughput of large binary values sent to and received from Homegear. The payload is stored in a system
+# variable and read back, once with bytes results and once with binaryAsMemoryView=True.
+#
+# Usage: binary_throughput.py [socket path] [payload sizes in MiB...]
+
+import sys
+import time
+from homegear import Homegear
+
+socketPath = sys.argv[1] if len(sys.argv) > 1 else "/var/run/homegear/homegearIPC.sock"
+sizes = [int(size) for size in sys.argv[2:]] or [1, 4, 16]
+repetitions = 10
+variableName = "PYTHON_BINARY_BENCHMARK"
+
+for binaryAsMemoryView in (False, True):
+	hg = Homegear(socketPath, binaryAsMemoryView=binaryAsMemoryView)
+	if not hg.connected():
+		sys.exit("Could not connect to " + socketPath)
+
+	for size in sizes:
+		payload = memoryview(bytearray(size << 20))
+
+		start = time.perf_counter()
+		for i in range(repetitions):
+			hg.setSystemVariable(variableName, payload)
+		setDuration = time.perf_counter() - start
+
+		start = time.perf_counter()
+		for i in range(repetitions):
+			result = hg.getSystemVariable(variableName)
+		getDuration = time.perf_counter() - start
+
+		if len(result) != len(payload):
+			sys.exit("Received " + str(len(result)) + " bytes instead of " + str(len(payload)))
+
+		print("{:>10} {:>4} MiB: set {:8.1f} MiB/s, get {:8.1f} MiB/s".format("memoryview" if binaryAsMemoryView else "bytes", size, size * repetitions / setDuration, size * repetitions / getDuration))
+
+	hg.deleteSystemVariable(variableName)
+	del hg
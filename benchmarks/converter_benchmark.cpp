@@ -0,0 +1,122 @@
+/* Copyright 2013-2019 Homegear GmbH
+ *
+ * Homegear is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * Homegear is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with Homegear.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ *
+ * In addition, as a special exception, the copyright holders give
+ * permission to link the code of portions of this program with the
+ * OpenSSL library under certain conditions as described in each
+ * individual source file, and distribute linked combinations
+ * including the two.
+ * You must obey the GNU Lesser General Public License in all respects
+ * for all of the code used other than OpenSSL.  If you modify
+ * file(s) with this exception, you may extend this exception to your
+ * version of the file(s), but you are not obligated to do so.  If you
+ * do not wish to do so, delete this exception statement from your
+ * version.  If you delete this exception statement from all source
+ * files in the program, then also delete it here.
+*/
+
+/*
+ * Measures PythonVariableConverter in both directions on typical payloads. Prints the results as JSON.
+ *
+ * Usage: converter_benchmark [seconds per benchmark]
+ */
+
+#include "../PythonVariableConverter.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <vector>
+
+struct Payload {
+  std::string name;
+  std::string expression;
+};
+
+static const std::vector<Payload> kPayloads{
+    {"scalars", "(42, 3.14, True, 'temperature', None)"},
+    {"wideStruct", "{'PARAMETER_' + str(i): i * 0.5 for i in range(1000)}"},
+    {"deepNesting", "functools.reduce(lambda child, i: {'level': i, 'values': [1.5, 'x'], 'child': child}, range(50), [1, 2, 3])"},
+    {"largeBinary", "bytes(4 << 20)"}
+};
+
+template<typename Function>
+static void measure(const std::string &payloadName, const std::string &operation, double duration, Function function, bool &first) {
+  uint64_t iterations = 0;
+  auto start = std::chrono::steady_clock::now();
+  auto end = start + std::chrono::duration<double>(duration);
+  auto now = start;
+  while (now < end) {
+    for (int i = 0; i < 10; i++) {
+      function();
+    }
+    iterations += 10;
+    now = std::chrono::steady_clock::now();
+  }
+  double seconds = std::chrono::duration<double>(now - start).count();
+  printf("%s    {\"name\": \"converter.%s\", \"payload\": \"%s\", \"iterations\": %llu, \"seconds\": %f, \"operationsPerSecond\": %f, \"nanosecondsPerOperation\": %f}",
+         first ? "" : ",\n", operation.c_str(), payloadName.c_str(), (unsigned long long)iterations, seconds, iterations / seconds, seconds / iterations * 1e9);
+  first = false;
+}
+
+int main(int argc, char *argv[]) {
+  double duration = argc > 1 ? std::atof(argv[1]) : 1.0;
+  if (duration <= 0) duration = 1.0;
+
+  Py_Initialize();
+  auto converter = new PythonVariableConverter();
+  if (converter->init() < 0) {
+    PyErr_Print();
+    return 1;
+  }
+
+  PyObject *globals = PyDict_New();
+  PyDict_SetItemString(globals, "__builtins__", PyEval_GetBuiltins());
+  PyObject *functools = PyImport_ImportModule("functools");
+  if (!functools) {
+    PyErr_Print();
+    return 1;
+  }
+  PyDict_SetItemString(globals, "functools", functools);
+  Py_DECREF(functools);
+
+  Metrics metrics; //Counted like in the module
+  printf("{\n  \"python\": \"%s\",\n  \"results\": [\n", Py_GetVersion());
+  bool first = true;
+  for (auto &payload : kPayloads) {
+    PyObject *value = PyRun_String(payload.expression.c_str(), Py_eval_input, globals, globals);
+    if (!value) {
+      PyErr_Print();
+      return 1;
+    }
+
+    measure(payload.name, "getVariable", duration, [&]() { PythonVariableConverter::getVariable(value, &metrics.bytesToHomegear); }, first);
+
+    auto variable = PythonVariableConverter::getVariable(value, &metrics.bytesToHomegear);
+    measure(payload.name, "getPythonVariable", duration, [&]() { Py_XDECREF(converter->getPythonVariable(variable, metrics.bytesToPython)); }, first);
+    measure(payload.name, "getPythonVariableMemoryView", duration, [&]() { Py_XDECREF(converter->getPythonVariable(variable, metrics.bytesToPython, true)); }, first);
+    measure(payload.name, "getPythonVariableLazy", duration, [&]() { Py_XDECREF(converter->getPythonVariable(variable, metrics.bytesToPython, false, true)); }, first);
+
+    Py_DECREF(value);
+  }
+  printf("\n  ]\n}\n");
+
+  Py_DECREF(globals);
+  delete converter;
+  Py_Finalize();
+  return 0;
+}
@@ -0,0 +1,238 @@
+#!/usr/bin/env python3
+# Minimal Unix socket server speaking the Homegear binary RPC protocol as used by libhomegear-ipc. Used by the benchmarks,
+# so no real Homegear is needed.
+#
+# Every packet starts with "Bin", a type byte (0x00 request, 0x01 response, 0xFF error response) and the payload size as
+# 32 bit big endian integer. Requests contain the method name and the parameters. Over IPC, the parameters are always
+# [threadId, packetId, [actual parameters]] and responses are [threadId, packetId, result], so both sides can match
+# responses to the waiting thread.
+#
+# Methods:
+#   benchmarkEcho(value)              Returns value.
+#   benchmarkEvents(count, variables) Sends count broadcastEvent requests with the passed number of variables each and returns count.
+#   system.multicall(calls)           Executes the calls.
+#   getValue(peerId, channel, name)   Returns 0.
+#   Any other method                  Returns the parameters.
+#
+# Usage: stub_server.py <socket path>
+
+import math
+import os
+import socketserver
+import struct
+import sys
+import threading
+
+TYPE_VOID = 0x00
+TYPE_INTEGER = 0x01
+TYPE_BOOLEAN = 0x02
+TYPE_STRING = 0x03
+TYPE_FLOAT = 0x04
+TYPE_BASE64 = 0x11
+TYPE_BINARY = 0xD0
+TYPE_INTEGER64 = 0xD1
+TYPE_ARRAY = 0x100
+TYPE_STRUCT = 0x101
+
+PACKET_REQUEST = 0x00
+PACKET_RESPONSE = 0x01
+PACKET_ERROR = 0xFF
+
+
+class Encoder:
+	def __init__(self):
+		self.data = bytearray()
+
+	def encodeString(self, value):
+		encoded = value.encode("utf-8") if isinstance(value, str) else bytes(value)
+		self.data += struct.pack(">i", len(encoded))
+		self.data += encoded
+
+	def encodeFloat(self, value):
+		# Same representation as Homegear's BinaryEncoder: mantissa * 2^exponent with the mantissa in [0.5, 1).
+		temp = abs(value)
+		exponent = 0
+		if temp != 0 and temp < 0.5:
+			while temp < 0.5:
+				temp *= 2
+				exponent -= 1
+		else:
+			while temp >= 1:
+				temp /= 2
+				exponent += 1
+		if value < 0:
+			temp = -temp
+		self.data += struct.pack(">ii", int(round(temp * 0x40000000)), exponent)
+
+	def encodeVariable(self, value):
+		if value is None:
+			# Homegear encodes void as empty string.
+			self.data += struct.pack(">i", TYPE_STRING)
+			self.encodeString("")
+		elif isinstance(value, bool):
+			self.data += struct.pack(">ib", TYPE_BOOLEAN, 1 if value else 0)
+		elif isinstance(value, int):
+			if -0x80000000 <= value <= 0x7FFFFFFF:
+				self.data += struct.pack(">ii", TYPE_INTEGER, value)
+			else:
+				self.data += struct.pack(">iq", TYPE_INTEGER64, value)
+		elif isinstance(value, float):
+			self.data += struct.pack(">i", TYPE_FLOAT)
+			self.encodeFloat(value)
+		elif isinstance(value, str):
+			self.data += struct.pack(">i", TYPE_STRING)
+			self.encodeString(value)
+		elif isinstance(value, (bytes, bytearray, memoryview)):
+			self.data += struct.pack(">i", TYPE_BINARY)
+			self.encodeString(value)
+		elif isinstance(value, (list, tuple)):
+			self.data += struct.pack(">ii", TYPE_ARRAY, len(value))
+			for element in value:
+				self.encodeVariable(element)
+		elif isinstance(value, dict):
+			self.data += struct.pack(">ii", TYPE_STRUCT, len(value))
+			for key, element in value.items():
+				self.encodeString(str(key))
+				self.encodeVariable(element)
+		else:
+			raise TypeError("Unsupported type: " + type(value).__name__)
+
+
+def encodeRequest(methodName, parameters):
+	encoder = Encoder()
+	encoder.encodeString(methodName)
+	encoder.data += struct.pack(">i", len(parameters))
+	for parameter in parameters:
+		encoder.encodeVariable(parameter)
+	return b"Bin" + bytes([PACKET_REQUEST]) + struct.pack(">I", len(encoder.data)) + encoder.data
+
+
+def encodeResponse(value, error=False):
+	encoder = Encoder()
+	encoder.encodeVariable(value)
+	return b"Bin" + bytes([PACKET_ERROR if error else PACKET_RESPONSE]) + struct.pack(">I", len(encoder.data)) + encoder.data
+
+
+class Decoder:
+	def __init__(self, data):
+		self.data = data
+		self.position = 0
+
+	def decodeInteger(self):
+		value = struct.unpack_from(">i", self.data, self.position)[0]
+		self.position += 4
+		return value
+
+	def decodeString(self):
+		size = self.decodeInteger()
+		value = bytes(self.data[self.position:self.position + size])
+		self.position += size
+		return value
+
+	def decodeVariable(self):
+		variableType = self.decodeInteger()
+		if variableType == TYPE_VOID:
+			return None
+		elif variableType == TYPE_INTEGER:
+			return self.decodeInteger()
+		elif variableType == TYPE_BOOLEAN:
+			value = self.data[self.position] != 0
+			self.position += 1
+			return value
+		elif variableType == TYPE_STRING or variableType == TYPE_BASE64:
+			return self.decodeString().decode("utf-8", "replace")
+		elif variableType == TYPE_FLOAT:
+			mantissa = self.decodeInteger()
+			exponent = self.decodeInteger()
+			return (mantissa / 0x40000000) * math.pow(2, exponent)
+		elif variableType == TYPE_BINARY:
+			return self.decodeString()
+		elif variableType == TYPE_INTEGER64:
+			value = struct.unpack_from(">q", self.data, self.position)[0]
+			self.position += 8
+			return value
+		elif variableType == TYPE_ARRAY:
+			return [self.decodeVariable() for i in range(self.decodeInteger())]
+		elif variableType == TYPE_STRUCT:
+			result = {}
+			for i in range(self.decodeInteger()):
+				key = self.decodeString().decode("utf-8", "replace")
+				result[key] = self.decodeVariable()
+			return result
+		raise ValueError("Unknown variable type: " + hex(variableType))
+
+
+class Connection(socketserver.BaseRequestHandler):
+	def setup(self):
+		self.sendLock = threading.Lock()
+		self.packetId = 0
+
+	def send(self, data):
+		with self.sendLock:
+			self.request.sendall(data)
+
+	def readExactly(self, size):
+		data = bytearray()
+		while len(data) < size:
+			chunk = self.request.recv(size - len(data))
+			if not chunk:
+				return None
+			data += chunk
+		return data
+
+	def sendEvents(self, count, variableCount):
+		names = ["VARIABLE_" + str(i) for i in range(variableCount)]
+		for i in range(count):
+			self.packetId += 1
+			self.send(encodeRequest("broadcastEvent", [0, self.packetId, ["device", 1 + i % 100, 1, names, [float(i)] * variableCount]]))
+
+	def execute(self, methodName, parameters):
+		if methodName == "benchmarkEcho":
+			return parameters[0] if parameters else None
+		elif methodName == "benchmarkEvents":
+			count = parameters[0] if parameters else 1
+			variableCount = parameters[1] if len(parameters) > 1 else 1
+			# Sent from another thread, so the responses of the client can be read in the meantime.
+			threading.Thread(target=self.sendEvents, args=(count, variableCount)).start()
+			return count
+		elif methodName == "system.multicall":
+			return [[self.execute(call["methodName"], call["params"])] for call in parameters[0]]
+		elif methodName == "getValue":
+			return 0
+		return parameters
+
+	def handle(self):
+		while True:
+			header = self.readExactly(8)
+			if header is None or header[0:3] != b"Bin":
+				return
+			payload = self.readExactly(struct.unpack(">I", header[4:8])[0])
+			if payload is None:
+				return
+			if header[3] != PACKET_REQUEST:
+				continue # Response to one of our broadcastEvent requests.
+
+			decoder = Decoder(payload)
+			methodName = decoder.decodeString().decode("utf-8")
+			parameters = [decoder.decodeVariable() for i in range(decoder.decodeInteger())]
+			if len(parameters) != 3:
+				self.send(encodeResponse({"faultCode": -1, "faultString": "Wrong parameter count."}, True))
+				continue
+			threadId, packetId, methodParameters = parameters
+			self.send(encodeResponse([threadId, packetId, self.execute(methodName, methodParameters)]))
+
+
+class Server(socketserver.ThreadingMixIn, socketserver.UnixStreamServer):
+	daemon_threads = True
+
+
+if __name__ == "__main__":
+	if len(sys.argv) != 2:
+		sys.exit("Usage: stub_server.py <socket path>")
+	if os.path.exists(sys.argv[1]):
+		os.unlink(sys.argv[1])
+	server = Server(sys.argv[1], Connection)
+	try:
+		server.serve_forever()
+	finally:
+		os.unlink(sys.argv[1])
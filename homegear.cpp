@@ -29,8 +29,20 @@
 */
 
 #include <Python.h>
+#include <structmember.h>
 #include "IpcClient.h"
+#include "AsyncBridge.h"
+#include "DispatchPool.h"
+#include "IpcClientPool.h"
+#include "Metrics.h"
+#include "EventQueue.h"
 #include "PythonVariableConverter.h"
+#include "ValueCache.h"
+#include "OfflineQueue.h"
+#include "WriteBuffer.h"
+#include <cmath>
+#include <deque>
+#include <unordered_map>
 #include <unordered_set>
 
 #if PY_MAJOR_VERSION > 3
@@ -39,6 +51,24 @@
 #error "Python version < 3 is not supported."
 #endif
 
+#if PY_VERSION_HEX < 0x03090000
+#error "Python versions below 3.9 are not supported."
+#endif
+
+#ifndef Py_TPFLAGS_IMMUTABLETYPE
+#define Py_TPFLAGS_IMMUTABLETYPE 0
+#endif
+#ifndef Py_TPFLAGS_DISALLOW_INSTANTIATION
+#define Py_TPFLAGS_DISALLOW_INSTANTIATION 0
+#endif
+
+static const size_t kMaxDispatchBatch = 1024; //Maximum number of queued events converted and dispatched under one GIL acquisition
+
+static const Py_ssize_t kMaxCachedMethods = 1024;
+
+static const size_t kDispatchQueueSize = 1024; //Maximum number of queued events and node input messages per dispatch worker
+static const size_t kPullEventQueueSize = 65536; //Capacity of the event queue with pullEvents when eventQueueSize is not set
+
 static const std::unordered_set<std::string> kNodeMethods{
     "nodeEvent",
     "nodeOutput",
@@ -53,300 +83,2065 @@ static const std::unordered_set<std::string> kNodeMethods{
     "setNodeCredentials"
 };
 
+/**
+ * Per-interpreter state of the module. Each interpreter importing the module gets its own types and converter, so no Python object is shared between
+ * interpreters.
+ */
+typedef struct {
+  PyObject *homegearType = nullptr;
+  PyObject *rpcMethodType = nullptr;
+  PyObject *eventStreamType = nullptr;
+  PyObject *resultIteratorType = nullptr;
+  PythonVariableConverter *converter = nullptr;
+} HomegearModuleState;
+
+/**
+ * How the result of an asyncio mode call is converted before it is set on the future.
+ */
+enum class HomegearResultKind : int32_t {
+  kDefault,
+  kMulticall, //Unpacked by Homegear_getMulticallResult()
+  kValueColumns, //Converted to columns by Homegear_getValueColumnsResult()
+  kIterator //Returned as HomegearResultIterator by Homegear_getResultIterator()
+};
+
+typedef struct {
+  HomegearResultKind kind = HomegearResultKind::kDefault;
+  size_t expectedSize = 0; //Number of calls of getValueColumns(), the response must contain one result per call
+} HomegearFutureResult;
+
+/**
+ * Thread states of the callback threads of one Homegear object. They are kept between callbacks, so each callback only swaps the GIL and thread-local
+ * Python state survives between callbacks. The object's threads are joined before it is freed, so all thread states are deleted together with the object
+ * and none is left behind when the interpreter ends.
+ */
+class HomegearThreadStates {
+ public:
+  explicit HomegearThreadStates(PyInterpreterState *interpreter) : _interpreter(interpreter) {}
+
+  /**
+   * Deletes the thread states. Must be called with the GIL held and after all threads using them were joined.
+   */
+  ~HomegearThreadStates() {
+    //Python deletes the thread states of all other threads itself when it is finalized.
+#if PY_VERSION_HEX >= 0x030D0000
+    if (Py_IsFinalizing()) return;
+#else
+    if (_Py_IsFinalizing()) return;
+#endif
+    for (auto &entry : _threadStates) {
+      PyThreadState_Clear(entry.second);
+      PyThreadState_Delete(entry.second);
+    }
+  }
+
+  PyThreadState *get() {
+    std::lock_guard<std::mutex> guard(_mutex);
+    auto threadStateIterator = _threadStates.find(std::this_thread::get_id());
+    if (threadStateIterator != _threadStates.end()) return threadStateIterator->second;
+    //Python threads already have a thread state. Threads of other interpreters and threads not created by Python get a new one.
+    PyThreadState *threadState = PyGILState_GetThisThreadState();
+    if (threadState && PyThreadState_GetInterpreter(threadState) == _interpreter) return threadState;
+    threadState = PyThreadState_New(_interpreter);
+    _threadStates.emplace(std::this_thread::get_id(), threadState);
+    return threadState;
+  }
+ private:
+  PyInterpreterState *_interpreter = nullptr;
+  std::mutex _mutex;
+  std::unordered_map<std::thread::id, PyThreadState *> _threadStates;
+};
+
 typedef struct {
   PyObject_HEAD
+  HomegearModuleState *moduleState = nullptr; //Kept alive by the type, which references the module
+  PythonVariableConverter *converter = nullptr; //Owned by moduleState
+  PyInterpreterState *interpreter = nullptr; //The interpreter the object was created in, used by the callback threads
+  HomegearThreadStates *threadStates = nullptr;
   std::string *socketPath = nullptr;
-  IpcClient *ipcClient = nullptr;
+  IpcClient *ipcClient = nullptr; //Primary client, receives the events
+  IpcClientPool *ipcClientPool = nullptr; //Used for all calls, contains ipcClient
   PyObject *eventCallback = nullptr;
+  bool batchEvents = false; //Call eventCallback once per broadcastEvent with a dict of all variables
+  ValueCache *valueCache = nullptr; //Only set when valueCacheSize was passed
+  Metrics *metrics = nullptr;
+  bool binaryAsMemoryView = false; //Return binary values as memoryview referencing the received data instead of copying them into bytes
+  bool lazyContainers = false; //Return structs and arrays of RPC results as HomegearStruct and HomegearArray proxies
+  EventQueue *eventQueue = nullptr;
+  WriteBuffer *writeBuffer = nullptr; //Only set when writeBehindInterval was passed
+  PyObject *writeErrorCallback = nullptr; //Called for failed writes of the write buffer and the offline queue
+  OfflineQueue *offlineQueue = nullptr; //Only set when offlineQueueSize was passed
+  bool pullEvents = false; //Events are only queued and returned by drain()
+  std::thread *eventDispatcherThread = nullptr;
+  DispatchPool *dispatchPool = nullptr; //Only set when dispatchWorkers was passed
+  std::atomic_bool deallocating{false}; //Set by the dealloc before the dispatch pool is stopped. Jobs taken by the workers afterwards are skipped.
+  PyObject *subscriptions = nullptr; //Dict of subscription ID => callback
   std::mutex *onConnectWaitMutex = nullptr;
   std::condition_variable *onConnectConditionVariable = nullptr;
+  double connectTimeout = 2; //Seconds the constructor waits for the connection, 0 to return immediately
+  PyObject *connectCallback = nullptr; //Called every time the connection is established
 
 // {{{ Variables and methods for use as Node-BLUE node
   std::string *nodeId = nullptr;
+  Ipc::PVariable *nodeIdVariable = nullptr; //Prepended to the parameters of all Node-BLUE methods, only set when nodeId is not empty
   PyObject *nodeInputCallback = nullptr;
+  std::mutex *nodeInfoMutex = nullptr; //Protects nodeInfo and nodeInfoObject
+  Ipc::PVariable *nodeInfo = nullptr; //The last node info received with a node input message
+  PyObject *nodeInfoObject = nullptr; //The converted node info. Passed to the callback again as long as the node info does not change.
+// }}}
+
+// {{{ Variables for asyncio mode
+  AsyncBridge *asyncBridge = nullptr;
+  uint32_t asyncWorkers = 0;
+  PyObject *loop = nullptr;
+  PyObject *pendingFutures = nullptr; //Dict of call ID => future
+  std::mutex *futureMutex = nullptr; //Protects currentFutureId and futureResultKinds, which are not protected by the GIL in free-threaded builds
+  uint64_t currentFutureId = 0;
+  std::unordered_map<uint64_t, HomegearFutureResult> *futureResultKinds = nullptr; //Futures of multicall() and getValueColumns() whose results need to be unpacked
+  std::vector<uint64_t> *connectFutureIds = nullptr; //Futures of waitConnected(), resolved by Homegear_onConnect(). Protected by onConnectWaitMutex.
+  PyObject *eventStreams = nullptr; //List of weak references to HomegearEventStream objects
+  std::atomic_bool hasEventStreams{false}; //Set while eventStreams might contain live streams, read by the IPC thread
 // }}}
+
+  PyObject *methodCache = nullptr; //Dict of attribute name => HomegearRpcMethod
+  PyObject *weakReferences = nullptr;
 } HomegearObject;
 
 static PyObject *Homegear_call(PyObject *object, PyObject *attrName);
 static void Homegear_dealloc(HomegearObject *self);
+static int Homegear_traverse(HomegearObject *self, visitproc visit, void *arg);
+static int Homegear_clear(HomegearObject *self);
 static int Homegear_init(HomegearObject *self, PyObject *arg);
 static PyObject *Homegear_new(PyTypeObject *type, PyObject *arg, PyObject *kw);
+static PyObject *Homegear_events(HomegearObject *self, PyObject *unused);
+static PyObject *Homegear_eventQueueStats(HomegearObject *self, PyObject *unused);
+static PyObject *Homegear_fileno(HomegearObject *self, PyObject *unused);
+static PyObject *Homegear_drain(HomegearObject *self, PyObject *args, PyObject *kw);
+static PyObject *Homegear_subscribe(HomegearObject *self, PyObject *args, PyObject *kw);
+static PyObject *Homegear_unsubscribe(HomegearObject *self, PyObject *args);
+static PyObject *Homegear_multicall(HomegearObject *self, PyObject *calls);
+static PyObject *Homegear_invokeAsync(HomegearObject *self, const std::string &methodName, const Ipc::PArray &parameters, HomegearResultKind resultKind, std::function<void(const Ipc::PVariable &result)> resultHandler, Metrics::MethodStats *stats, size_t expectedSize = 0);
+static PyObject *Homegear_stats(HomegearObject *self, PyObject *unused);
+static PyObject *Homegear_resetStats(HomegearObject *self, PyObject *unused);
+static PyObject *Homegear_getResolvedFuture(HomegearObject *self, PyObject *value);
+static PyObject *Homegear_valueCacheStats(HomegearObject *self, PyObject *unused);
+static PyObject *Homegear_flush(HomegearObject *self, PyObject *unused);
+static PyObject *Homegear_writeBufferStats(HomegearObject *self, PyObject *unused);
+static PyObject *Homegear_offlineQueueStats(HomegearObject *self, PyObject *unused);
+static PyObject *Homegear_waitConnected(HomegearObject *self, PyObject *args, PyObject *kw);
+static PyObject *Homegear_addPendingFuture(HomegearObject *self, uint64_t &futureId);
+static PyObject *Homegear_nodeOutputMany(HomegearObject *self, PyObject *args);
+static PyObject *Homegear_getValueColumns(HomegearObject *self, PyObject *keys);
+static PyObject *Homegear_iter(HomegearObject *self, PyObject *args);
+static PyObject *Homegear_getResultIterator(HomegearObject *self, const Ipc::PVariable &result);
 
 static PyMethodDef HomegearMethods[] = {
+    {"waitConnected", (PyCFunction)(void (*)(void))Homegear_waitConnected, METH_VARARGS | METH_KEYWORDS, "waitConnected(timeout=None)\n"
+                                                                                                          "Waits until the connection to Homegear is established. Returns False on timeout. "
+                                                                                                          "Returns a future in asyncio mode."},
+    {"events", (PyCFunction)Homegear_events, METH_NOARGS, "Returns an asynchronous iterator over all events. Only available in asyncio mode."},
+    {"eventQueueStats", (PyCFunction)Homegear_eventQueueStats, METH_NOARGS, "Returns the size, capacity and the number of dropped and coalesced events of the event queue or the queues of the dispatch workers."},
+    {"fileno", (PyCFunction)Homegear_fileno, METH_NOARGS, "fileno()\nReturns a file descriptor, which is readable while events are queued. Only available with pullEvents."},
+    {"drain", (PyCFunction)(void (*)(void))Homegear_drain, METH_VARARGS | METH_KEYWORDS, "drain(maxEvents=None)\nReturns a list of the queued events and calls the "
+                                                                                       "subscription callbacks of queued subscription events. Only available with pullEvents."},
+    {"subscribe", (PyCFunction)(void (*)(void))Homegear_subscribe, METH_VARARGS | METH_KEYWORDS, "subscribe(callback, peerIds=None, channels=None, variables=None, eventSources=None)\n"
+                                                                                                "Calls callback for matching events only. Returns the subscription ID."},
+    {"unsubscribe", (PyCFunction)Homegear_unsubscribe, METH_VARARGS, "unsubscribe(subscriptionId)\nRemoves a subscription. Returns False if the ID is unknown."},
+    {"stats", (PyCFunction)Homegear_stats, METH_NOARGS, "Returns call, event, callback and conversion statistics."},
+    {"resetStats", (PyCFunction)Homegear_resetStats, METH_NOARGS, "Resets the statistics returned by stats()."},
+    {"valueCacheStats", (PyCFunction)Homegear_valueCacheStats, METH_NOARGS, "Returns the size, capacity and the number of hits and misses of the value cache."},
+    {"flush", (PyCFunction)Homegear_flush, METH_NOARGS, "flush()\nSends all buffered writes and waits until they were executed. Returns False when there is no connection."},
+    {"writeBufferStats", (PyCFunction)Homegear_writeBufferStats, METH_NOARGS, "Returns the number of buffered, coalesced and sent writes of the write buffer."},
+    {"offlineQueueStats", (PyCFunction)Homegear_offlineQueueStats, METH_NOARGS, "Returns the number of queued, coalesced, spilled, dropped and replayed writes of the offline queue."},
+    {"multicall", (PyCFunction)Homegear_multicall, METH_O, "multicall(calls)\nExecutes a list of calls like [(\"setValue\", 1, 1, \"STATE\", True), ...] in one request.\n"
+                                                            "Returns the results in order. Failed calls are returned as Exception objects."},
+    {"getValueColumns", (PyCFunction)Homegear_getValueColumns, METH_O, "getValueColumns(keys)\nReads the values of a list of (peerId, channel, variable) keys in "
+                                                                     "one request. Returns the tuple (values, valid) of read-only memoryviews."},
+    {"iter", (PyCFunction)Homegear_iter, METH_VARARGS, "iter(methodName, *parameters)\nCalls the method and returns an iterator over the elements of the "
+                                                     "resulting array or the (key, value) tuples of the resulting struct. Consumed elements are freed."},
+    {"nodeOutputMany", (PyCFunction)Homegear_nodeOutputMany, METH_VARARGS, "nodeOutputMany(outputIndex, messages)\nSends a list of messages to one output of the "
+                                                                            "Node-BLUE node in one request. Returns the results like multicall()."},
     {nullptr, nullptr, 0, nullptr}
 };
 
-#if __GNUC__ > 7
-static PyTypeObject HomegearObjectType = {
-    .ob_base =  PyVarObject_HEAD_INIT(nullptr, 0)
-    .tp_name =   "homegear.Homegear",
-    .tp_basicsize =  sizeof(HomegearObject),
-    .tp_dealloc =  (destructor)Homegear_dealloc,
-    .tp_getattro =  Homegear_call,
-    .tp_flags =  Py_TPFLAGS_DEFAULT,
-    .tp_doc =  "Class to locally communicate with Homegear.",
-    .tp_methods =  HomegearMethods,
-    .tp_init =  (initproc)Homegear_init,
-    .tp_new =  Homegear_new,
+static PyMemberDef HomegearMembers[] = {
+    {"__weaklistoffset__", T_PYSSIZET, offsetof(HomegearObject, weakReferences), READONLY, nullptr},
+    {nullptr, 0, 0, 0, nullptr}
 };
-#else
-static PyTypeObject HomegearObjectType = {
-        PyVarObject_HEAD_INIT(nullptr, 0)
-        "homegear.Homegear",               // tp_name (module name, object name)
-        sizeof(HomegearObject),            // tp_basicsize
-        0,                                 // tp_itemsize
-        (destructor)Homegear_dealloc,      // tp_dealloc
-#if PY_MINOR_VERSION >= 8
-        0,                                 // tp_vectorcall_offset
-#else
-        nullptr,                           // tp_print
-#endif
-        nullptr,                           // tp_getattr
-        nullptr,                           // tp_setattr
-        nullptr,                           // tp_as_async
-        nullptr,                           // tp_repr
-        nullptr,                           // tp_as_number
-        nullptr,                           // tp_as_sequence
-        nullptr,                           // tp_as_mapping
-        nullptr,                           // tp_hash
-        nullptr,                           // tp_call
-        nullptr,                           // tp_str
-        Homegear_call,                     // tp_getattro
-        nullptr,                           // tp_setattro
-        nullptr,                           // tp_as_buffer
-        Py_TPFLAGS_DEFAULT,                // tp_flags
-        "Class to locally communicate with Homegear.", // tp_doc
-        nullptr,                           // tp_traverse
-        nullptr,                           // tp_clear
-        nullptr,                           // tp_richcompare
-        0,                                 // tp_weaklistoffset
-        nullptr,                           // tp_iter
-        nullptr,                           // tp_iternext
-        HomegearMethods,                   // tp_methods
-        nullptr,                           // tp_members
-        nullptr,                           // tp_getset
-        nullptr,                           // tp_base
-        nullptr,                           // tp_dict
-        nullptr,                           // tp_descr_get
-        nullptr,                           // tp_descr_set
-        0,                                 // tp_dictoffset
-        (initproc)Homegear_init,           // tp_init
-        nullptr,                           // tp_alloc
-        Homegear_new,                      // tp_new
-        nullptr,                           // tp_free
-#if PY_MINOR_VERSION >= 8
-        nullptr,                           // tp_is_gc
-#endif
+
+static PyType_Slot HomegearObjectSlots[] = {
+    {Py_tp_dealloc, (void *)Homegear_dealloc},
+    {Py_tp_getattro, (void *)Homegear_call},
+    {Py_tp_doc, (void *)"Class to locally communicate with Homegear."},
+    {Py_tp_traverse, (void *)Homegear_traverse},
+    {Py_tp_clear, (void *)Homegear_clear},
+    {Py_tp_methods, HomegearMethods},
+    {Py_tp_members, HomegearMembers},
+    {Py_tp_init, (void *)Homegear_init},
+    {Py_tp_new, (void *)Homegear_new},
+    {0, nullptr}
 };
+
+static PyType_Spec HomegearObjectSpec = {
+    "homegear.Homegear",
+    sizeof(HomegearObject),
+    0,
+    Py_TPFLAGS_DEFAULT | Py_TPFLAGS_HAVE_GC | Py_TPFLAGS_IMMUTABLETYPE,
+    HomegearObjectSlots
+};
+
+typedef struct {
+  PyObject_HEAD
+  PyObject *loop = nullptr;
+  PyObject *waiter = nullptr; //Future returned by __anext__() while no event is queued
+  std::deque<PyObject *> *events = nullptr;
+  PyObject *weakReferences = nullptr;
+} HomegearEventStream;
+
+static void HomegearEventStream_dealloc(HomegearEventStream *self);
+static int HomegearEventStream_traverse(HomegearEventStream *self, visitproc visit, void *arg);
+static int HomegearEventStream_clear(HomegearEventStream *self);
+static PyObject *HomegearEventStream_aiter(PyObject *self);
+static PyObject *HomegearEventStream_anext(HomegearEventStream *self);
+
+static PyMemberDef HomegearEventStreamMembers[] = {
+    {"__weaklistoffset__", T_PYSSIZET, offsetof(HomegearEventStream, weakReferences), READONLY, nullptr},
+    {nullptr, 0, 0, 0, nullptr}
+};
+
+static PyType_Slot HomegearEventStreamSlots[] = {
+    {Py_tp_dealloc, (void *)HomegearEventStream_dealloc},
+    {Py_am_aiter, (void *)HomegearEventStream_aiter},
+    {Py_am_anext, (void *)HomegearEventStream_anext},
+    {Py_tp_doc, (void *)"Asynchronous iterator over Homegear events."},
+    {Py_tp_traverse, (void *)HomegearEventStream_traverse},
+    {Py_tp_clear, (void *)HomegearEventStream_clear},
+    {Py_tp_members, HomegearEventStreamMembers},
+    {0, nullptr}
+};
+
+static PyType_Spec HomegearEventStreamSpec = {
+    "homegear.HomegearEventStream",
+    sizeof(HomegearEventStream),
+    0,
+    Py_TPFLAGS_DEFAULT | Py_TPFLAGS_HAVE_GC | Py_TPFLAGS_IMMUTABLETYPE | Py_TPFLAGS_DISALLOW_INSTANTIATION,
+    HomegearEventStreamSlots
+};
+
+static void HomegearEventStream_dealloc(HomegearEventStream *self) {
+  PyObject_GC_UnTrack(self);
+  if (self->weakReferences) PyObject_ClearWeakRefs((PyObject *)self);
+  HomegearEventStream_clear(self);
+  if (self->events) {
+    delete self->events;
+    self->events = nullptr;
+  }
+
+  PyTypeObject *type = Py_TYPE(self);
+  type->tp_free(self);
+  Py_DECREF(type);
+}
+
+static int HomegearEventStream_traverse(HomegearEventStream *self, visitproc visit, void *arg) {
+  Py_VISIT(Py_TYPE(self));
+  Py_VISIT(self->loop);
+  Py_VISIT(self->waiter);
+  if (self->events) {
+    for (auto event : *self->events) {
+      Py_VISIT(event);
+    }
+  }
+  return 0;
+}
+
+static int HomegearEventStream_clear(HomegearEventStream *self) {
+  Py_CLEAR(self->loop);
+  Py_CLEAR(self->waiter);
+  if (self->events) {
+    while (!self->events->empty()) {
+      Py_DECREF(self->events->front());
+      self->events->pop_front();
+    }
+  }
+  return 0;
+}
+
+static PyObject *HomegearEventStream_aiter(PyObject *self) {
+  Py_INCREF(self);
+  return self;
+}
+
+static bool Homegear_futureDone(PyObject *future) {
+  PyObject *done = PyObject_CallMethod(future, "done", nullptr);
+  if (!done) {
+    PyErr_Clear();
+    return true;
+  }
+  bool result = PyObject_IsTrue(done) == 1;
+  Py_DECREF(done);
+  return result;
+}
+
+static PyObject *HomegearEventStream_anext(HomegearEventStream *self) {
+  if (self->waiter && !Homegear_futureDone(self->waiter)) {
+    PyErr_SetString(PyExc_RuntimeError, "Another coroutine is already waiting for the next event of this stream.");
+    return nullptr;
+  }
+  Py_CLEAR(self->waiter);
+
+  PyObject *future = PyObject_CallMethod(self->loop, "create_future", nullptr);
+  if (!future) return nullptr;
+
+  if (self->events->empty()) {
+    Py_INCREF(future);
+    self->waiter = future;
+    return future;
+  }
+
+  PyObject *event = self->events->front();
+  self->events->pop_front();
+  PyObject *result = PyObject_CallMethod(future, "set_result", "(O)", event);
+  Py_DECREF(event);
+  if (!result) {
+    Py_DECREF(future);
+    return nullptr;
+  }
+  Py_DECREF(result);
+  return future;
+}
+
+static void HomegearEventStream_push(HomegearEventStream *self, PyObject *event) {
+  if (self->waiter && !Homegear_futureDone(self->waiter)) {
+    PyObject *result = PyObject_CallMethod(self->waiter, "set_result", "(O)", event);
+    Py_CLEAR(self->waiter);
+    if (result) {
+      Py_DECREF(result);
+      return;
+    }
+    PyErr_Clear();
+  }
+
+  Py_INCREF(event);
+  self->events->push_back(event);
+}
+
+#ifndef Py_BEGIN_CRITICAL_SECTION
+#define Py_BEGIN_CRITICAL_SECTION(op) {
+#define Py_END_CRITICAL_SECTION() }
 #endif
 
+/**
+ * Iterator over a large array or struct result. Each element is converted when it is requested and then removed from the received Variable, so the
+ * result is never held completely as Variable and as Python objects at the same time. The type references the module, which keeps the converter alive.
+ */
+typedef struct {
+  PyObject_HEAD
+  PythonVariableConverter *converter = nullptr;
+  Ipc::PVariable *result = nullptr;
+  std::shared_ptr<Metrics::Counter> *byteCounter = nullptr; //bytesToPython of the Homegear object, kept when the object is destroyed first
+  size_t position = 0; //Next array index
+  bool binaryAsMemoryView = false;
+  bool lazyContainers = false;
+} HomegearResultIterator;
+
+static void HomegearResultIterator_dealloc(HomegearResultIterator *self) {
+  if (self->result) {
+    delete self->result;
+    self->result = nullptr;
+  }
+  if (self->byteCounter) {
+    delete self->byteCounter;
+    self->byteCounter = nullptr;
+  }
+  PyTypeObject *type = Py_TYPE(self);
+  type->tp_free(self);
+  Py_DECREF(type);
+}
+
+static PyObject *HomegearResultIterator_iter(PyObject *self) {
+  Py_INCREF(self);
+  return self;
+}
+
+/**
+ * Returns the next element or nullptr without exception set when all elements were returned. Must be called within a critical section on self.
+ */
+static PyObject *HomegearResultIterator_getNext(HomegearResultIterator *self) {
+  auto &result = *self->result;
+  if (result->type == Ipc::VariableType::tArray) {
+    auto &arrayValue = *result->arrayValue;
+    if (self->position >= arrayValue.size()) {
+      arrayValue.clear();
+      arrayValue.shrink_to_fit();
+      return nullptr;
+    }
+    auto &element = arrayValue[self->position++];
+    PyObject *value = self->converter->getPythonVariable(element, *self->byteCounter, self->binaryAsMemoryView, self->lazyContainers);
+    element.reset();
+    return value;
+  } else if (result->type == Ipc::VariableType::tStruct) {
+    auto &structValue = *result->structValue;
+    if (structValue.empty()) return nullptr;
+    auto structIterator = structValue.begin();
+    PyObject *key = self->converter->getKey(structIterator->first);
+    PyObject *value = key ? self->converter->getPythonVariable(structIterator->second, *self->byteCounter, self->binaryAsMemoryView, self->lazyContainers) : nullptr;
+    structValue.erase(structIterator);
+    if (!value) {
+      Py_XDECREF(key);
+      return nullptr;
+    }
+    return Py_BuildValue("(NN)", key, value);
+  }
+  return nullptr;
+}
+
+static PyObject *HomegearResultIterator_next(HomegearResultIterator *self) {
+  PyObject *value = nullptr;
+  Py_BEGIN_CRITICAL_SECTION(self);
+  value = HomegearResultIterator_getNext(self);
+  Py_END_CRITICAL_SECTION();
+  return value;
+}
+
+static PyObject *HomegearResultIterator_lengthHint(HomegearResultIterator *self, PyObject *unused) {
+  size_t remaining = 0;
+  Py_BEGIN_CRITICAL_SECTION(self);
+  auto &result = *self->result;
+  if (result->type == Ipc::VariableType::tArray) remaining = result->arrayValue->size() > self->position ? result->arrayValue->size() - self->position : 0;
+  else if (result->type == Ipc::VariableType::tStruct) remaining = result->structValue->size();
+  Py_END_CRITICAL_SECTION();
+  return PyLong_FromSize_t(remaining);
+}
+
+static PyMethodDef HomegearResultIteratorMethods[] = {
+    {"__length_hint__", (PyCFunction)HomegearResultIterator_lengthHint, METH_NOARGS, nullptr},
+    {nullptr, nullptr, 0, nullptr}
+};
+
+static PyType_Slot HomegearResultIteratorSlots[] = {
+    {Py_tp_dealloc, (void *)HomegearResultIterator_dealloc},
+    {Py_tp_iter, (void *)HomegearResultIterator_iter},
+    {Py_tp_iternext, (void *)HomegearResultIterator_next},
+    {Py_tp_methods, HomegearResultIteratorMethods},
+    {Py_tp_doc, (void *)"Iterator over the elements of a large RPC result returned by iter()."},
+    {0, nullptr}
+};
+
+static PyType_Spec HomegearResultIteratorSpec = {
+    "homegear.HomegearResultIterator",
+    sizeof(HomegearResultIterator),
+    0,
+    Py_TPFLAGS_DEFAULT | Py_TPFLAGS_IMMUTABLETYPE | Py_TPFLAGS_DISALLOW_INSTANTIATION,
+    HomegearResultIteratorSlots
+};
+
+enum class HomegearRpcMethodKind : int32_t {
+  kRpc,
+  kNode, //Node-BLUE method, the node ID is prepended to the parameters
+  kConnected,
+  kCachedRead, //Answered by the value cache when enabled
+  kCacheWrite //Invalidates the value cache
+};
+
 typedef struct {
   PyObject_HEAD
+  vectorcallfunc vectorcall = nullptr;
   std::string *methodName = nullptr;
-  std::string *nodeId = nullptr;
-  IpcClient *ipcClient = nullptr;
+  HomegearRpcMethodKind kind = HomegearRpcMethodKind::kRpc;
+  std::atomic<Metrics::MethodStats *> stats{nullptr}; //Owned by the Metrics object of homegearObject. Set by the first call, which might run in parallel.
+  PyObject *homegearObject = nullptr; //Strong reference unless borrowedObject is set
+  bool borrowedObject = false; //Set for methods in the methodCache of homegearObject, which would otherwise form a cycle. Reset by the object's dealloc.
 } HomegearRpcMethod;
 
 static PyObject *HomegearRpcMethod_call(PyObject *object, PyObject *args, PyObject *kw);
+static PyObject *HomegearRpcMethod_vectorcall(PyObject *object, PyObject *const *args, size_t nargsf, PyObject *kwnames);
 static void HomegearRpcMethod_dealloc(HomegearRpcMethod *self);
+static int HomegearRpcMethod_traverse(HomegearRpcMethod *self, visitproc visit, void *arg);
+static int HomegearRpcMethod_clear(HomegearRpcMethod *self);
 static PyObject *HomegearRpcMethod_new(PyTypeObject *type, PyObject *arg, PyObject *kw);
 
-std::nullptr_t bla;
+std::nullptr_t bla;
+
+static PyMemberDef HomegearRpcMethodMembers[] = {
+    {"__vectorcalloffset__", T_PYSSIZET, offsetof(HomegearRpcMethod, vectorcall), READONLY, nullptr},
+    {nullptr, 0, 0, 0, nullptr}
+};
+
+static PyType_Slot HomegearRpcMethodSlots[] = {
+    {Py_tp_dealloc, (void *)HomegearRpcMethod_dealloc},
+    {Py_tp_call, (void *)HomegearRpcMethod_call},
+    {Py_tp_traverse, (void *)HomegearRpcMethod_traverse},
+    {Py_tp_clear, (void *)HomegearRpcMethod_clear},
+    {Py_tp_members, HomegearRpcMethodMembers},
+    {Py_tp_new, (void *)HomegearRpcMethod_new},
+    {0, nullptr}
+};
+
+static PyType_Spec HomegearRpcMethodSpec = {
+    "homegear.HomegearRpcMethod",
+    sizeof(HomegearRpcMethod),
+    0,
+    Py_TPFLAGS_DEFAULT | Py_TPFLAGS_HAVE_GC | Py_TPFLAGS_HAVE_VECTORCALL | Py_TPFLAGS_IMMUTABLETYPE,
+    HomegearRpcMethodSlots
+};
+
+static PyObject *HomegearRpcMethod_new(PyTypeObject *type, PyObject *arg, PyObject *kw) {
+  const char *methodName = nullptr;
+
+  switch (PyTuple_Size(arg)) {
+    case 1:if (!PyArg_ParseTuple(arg, "s", &methodName)) return nullptr;
+      break;
+    default:return nullptr;
+  }
+
+  if (!methodName) return nullptr;
+
+  auto self = (HomegearRpcMethod *)type->tp_alloc(type, 0);
+  if (!self) return nullptr;
+  //Py_INCREF(self); //valgrind does not complain if we don't do this and the dealloc is only called after setting the object to "None".
+  self->methodName = new std::string(methodName);
+  self->kind = HomegearRpcMethodKind::kRpc;
+  self->homegearObject = nullptr;
+  self->vectorcall = HomegearRpcMethod_vectorcall;
+
+  return (PyObject *)self;
+}
+
+static void HomegearRpcMethod_dealloc(HomegearRpcMethod *self) {
+  PyObject_GC_UnTrack(self);
+  if (self->methodName) {
+    delete self->methodName;
+    self->methodName = nullptr;
+  }
+
+  HomegearRpcMethod_clear(self);
+
+  PyTypeObject *type = Py_TYPE(self);
+  type->tp_free(self);
+  Py_DECREF(type);
+}
+
+static int HomegearRpcMethod_traverse(HomegearRpcMethod *self, visitproc visit, void *arg) {
+  Py_VISIT(Py_TYPE(self));
+  if (!self->borrowedObject) Py_VISIT(self->homegearObject);
+  return 0;
+}
+
+static int HomegearRpcMethod_clear(HomegearRpcMethod *self) {
+  if (self->borrowedObject) {
+    self->homegearObject = nullptr;
+    self->borrowedObject = false;
+  } else Py_CLEAR(self->homegearObject);
+  return 0;
+}
+
+/**
+ * Returns the fault string of an error struct or a generic message when it has none.
+ */
+static std::string Homegear_getFaultString(const Ipc::PVariable &error) {
+  if (error->type != Ipc::VariableType::tStruct) return "Unknown error.";
+  auto faultStringIterator = error->structValue->find("faultString");
+  if (faultStringIterator == error->structValue->end() || !faultStringIterator->second) return "Unknown error.";
+  return faultStringIterator->second->stringValue;
+}
+
+/**
+ * Executes the RPC method. The positional arguments are converted directly into the outgoing parameter array, both for vectorcall and for tp_call (the
+ * items of the argument tuple are passed).
+ */
+static PyObject *HomegearRpcMethod_invoke(HomegearRpcMethod *methodObject, PyObject *const *args, size_t argCount) {
+  auto homegearObject = (HomegearObject *)methodObject->homegearObject;
+
+  if (!homegearObject || !homegearObject->ipcClient) {
+    Py_RETURN_NONE;
+  }
+
+  if (methodObject->kind == HomegearRpcMethodKind::kConnected) {
+    if (homegearObject->ipcClient->connected()) {
+      Py_RETURN_TRUE;
+    } else {
+      Py_RETURN_FALSE;
+    }
+  }
+
+  //The statistics are created on the first call, so attributes that are never called don't add an entry. getMethodStats() returns the same entry for
+  //the same name, so parallel first calls store the same pointer.
+  Metrics::MethodStats *stats = methodObject->stats.load(std::memory_order_acquire);
+  if (!stats) {
+    stats = homegearObject->metrics->getMethodStats(*methodObject->methodName);
+    methodObject->stats.store(stats, std::memory_order_release);
+  }
+
+  bool asyncMode = homegearObject->asyncBridge;
+  bool writeMethod = methodObject->kind == HomegearRpcMethodKind::kCacheWrite && WriteBuffer::isWriteMethod(*methodObject->methodName);
+  bool queueOffline = homegearObject->offlineQueue && writeMethod;
+  bool bufferWrite = homegearObject->writeBuffer && writeMethod; //The write buffer keeps writes made without connection
+
+  if (!asyncMode && !queueOffline && !bufferWrite && !homegearObject->ipcClient->connected()) Py_RETURN_NONE;
+
+  Ipc::PArray parameters;
+  if (methodObject->kind == HomegearRpcMethodKind::kNode) {
+    if (!homegearObject->nodeIdVariable) {
+      PyErr_SetString(PyExc_Exception, "Node ID was not set in Object constructor.");
+      return nullptr;
+    }
+
+    parameters = PythonVariableConverter::getArray(args, argCount, &homegearObject->metrics->bytesToHomegear, *homegearObject->nodeIdVariable);
+  } else parameters = PythonVariableConverter::getArray(args, argCount, &homegearObject->metrics->bytesToHomegear);
+
+  //Writes made without connection are replayed by the offline queue's thread after the connection is established.
+  if (queueOffline) {
+    if (homegearObject->offlineQueue->push(*methodObject->methodName, parameters)) {
+      if (!asyncMode) Py_RETURN_NONE;
+      Py_INCREF(Py_None);
+      return Homegear_getResolvedFuture(homegearObject, Py_None);
+    }
+  }
+
+  //Buffered writes are sent by the write buffer's thread in order. The value cache is invalidated when they are executed.
+  if (bufferWrite && homegearObject->writeBuffer->push(*methodObject->methodName, parameters)) {
+    if (!asyncMode) Py_RETURN_NONE;
+    Py_INCREF(Py_None);
+    return Homegear_getResolvedFuture(homegearObject, Py_None);
+  }
+
+  //Writes still in the write buffer would otherwise be sent after this write, e. g. a system variable deleted here would be set again afterwards.
+  if (homegearObject->writeBuffer && methodObject->kind == HomegearRpcMethodKind::kCacheWrite && homegearObject->writeBuffer->size() > 0) {
+    Py_BEGIN_ALLOW_THREADS
+    homegearObject->writeBuffer->flush();
+    Py_END_ALLOW_THREADS
+  }
+
+  if (!asyncMode && !homegearObject->ipcClient->connected()) Py_RETURN_NONE;
+
+  std::function<void(const Ipc::PVariable &result)> cacheHandler;
+  if (homegearObject->valueCache) {
+    auto valueCache = homegearObject->valueCache;
+    ValueCache::Key cacheKey;
+    if (methodObject->kind == HomegearRpcMethodKind::kCachedRead && ValueCache::getReadKey(*methodObject->methodName, parameters, cacheKey)) {
+      if (!homegearObject->ipcClient->connected()) {
+        //Events are missed while the connection is down, so the cached values might be stale. The call goes to Homegear like without cache.
+        valueCache->clear();
+      } else {
+        //Cache hits are answered directly without releasing the GIL.
+        Ipc::PVariable cachedValue;
+        uint64_t cacheToken = 0;
+        if (valueCache->get(cacheKey, cachedValue, cacheToken)) {
+          PyObject *value = homegearObject->converter->getPythonVariable(cachedValue, homegearObject->metrics->bytesToPython, homegearObject->binaryAsMemoryView, homegearObject->lazyContainers);
+          if (!value || !asyncMode) return value;
+          return Homegear_getResolvedFuture(homegearObject, value);
+        }
+        cacheHandler = [valueCache, cacheKey, cacheToken](const Ipc::PVariable &result) { valueCache->set(cacheKey, cacheToken, result); };
+      }
+    } else if (methodObject->kind == HomegearRpcMethodKind::kCacheWrite) {
+      bool clearAll = false;
+      if (ValueCache::getWriteKey(*methodObject->methodName, parameters, cacheKey, clearAll)) {
+        cacheHandler = [valueCache, cacheKey, clearAll](const Ipc::PVariable &result) {
+          if (clearAll) valueCache->clear();
+          else valueCache->invalidate(cacheKey);
+        };
+      }
+    }
+  }
+
+  if (asyncMode) return Homegear_invokeAsync(homegearObject, *methodObject->methodName, parameters, HomegearResultKind::kDefault, std::move(cacheHandler), stats);
+
+  //The GIL is released while waiting for the response, so other Python threads and the event callbacks keep running. IIpcClient::invoke() matches
+  //responses to the calling thread, so several Python threads can have requests in flight on the same IpcClient at the same time.
+  Ipc::PVariable result;
+  Py_BEGIN_ALLOW_THREADS
+  result = homegearObject->ipcClientPool->invoke(*methodObject->methodName, parameters, stats);
+  if (cacheHandler) cacheHandler(result);
+  Py_END_ALLOW_THREADS
+
+  if (result->errorStruct) {
+    PyErr_SetString(PyExc_Exception, Homegear_getFaultString(result).c_str());
+    return nullptr;
+  }
+
+  return homegearObject->converter->getPythonVariable(result, homegearObject->metrics->bytesToPython, homegearObject->binaryAsMemoryView, homegearObject->lazyContainers);
+}
+
+/**
+ * Keeps the Homegear object alive while the call is in progress without the GIL, cached methods only hold a borrowed reference.
+ */
+static PyObject *HomegearRpcMethod_invokeWithReference(HomegearRpcMethod *methodObject, PyObject *const *args, size_t argCount) {
+  PyObject *homegearObject = methodObject->homegearObject;
+  Py_XINCREF(homegearObject);
+  PyObject *result = HomegearRpcMethod_invoke(methodObject, args, argCount);
+  Py_XDECREF(homegearObject);
+  return result;
+}
+
+static PyObject *HomegearRpcMethod_call(PyObject *object, PyObject *args, PyObject *kw) {
+  return HomegearRpcMethod_invokeWithReference((HomegearRpcMethod *)object, &PyTuple_GET_ITEM(args, 0), (size_t)PyTuple_GET_SIZE(args));
+}
+
+static PyObject *HomegearRpcMethod_vectorcall(PyObject *object, PyObject *const *args, size_t nargsf, PyObject *kwnames) {
+  //Like tp_call, keyword arguments are ignored.
+  return HomegearRpcMethod_invokeWithReference((HomegearRpcMethod *)object, args, (size_t)PyVectorcall_NARGS(nargsf));
+}
+
+/**
+ * Returns a new reference to a dict item or nullptr. Borrowed references returned by PyDict_GetItem() are not safe in free-threaded builds, where
+ * another thread can remove the item at any time.
+ */
+static PyObject *Homegear_getDictItem(PyObject *dict, PyObject *key) {
+#if PY_VERSION_HEX >= 0x030D0000
+  PyObject *item = nullptr;
+  if (PyDict_GetItemRef(dict, key, &item) == -1) PyErr_Clear();
+  return item;
+#else
+  PyObject *item = PyDict_GetItem(dict, key);
+  Py_XINCREF(item);
+  return item;
+#endif
+}
+
+/**
+ * Returns a new reference to the object of a weak reference or nullptr when the object is gone.
+ */
+static PyObject *Homegear_getWeakReferenceObject(PyObject *reference) {
+#if PY_VERSION_HEX >= 0x030D0000
+  PyObject *object = nullptr;
+  if (PyWeakref_GetRef(reference, &object) == -1) PyErr_Clear();
+  return object;
+#else
+  PyObject *object = PyWeakref_GetObject(reference);
+  if (object == Py_None) return nullptr;
+  Py_INCREF(object);
+  return object;
+#endif
+}
+
+/**
+ * Removes a dict item and returns a new reference to it or nullptr. Unlike a lookup followed by a removal, only one thread can take the item.
+ */
+static PyObject *Homegear_popDictItem(PyObject *dict, PyObject *key) {
+#if PY_VERSION_HEX >= 0x030D0000
+  PyObject *item = nullptr;
+  if (PyDict_Pop(dict, key, &item) == -1) PyErr_Clear();
+  return item;
+#else
+  PyObject *item = PyDict_GetItem(dict, key);
+  if (!item) return nullptr;
+  Py_INCREF(item);
+  if (PyDict_DelItem(dict, key) == -1) PyErr_Clear();
+  return item;
+#endif
+}
+
+/**
+ * Acquires the GIL in one of the callback threads and records the time spent waiting for it. PyGILState_Ensure() always uses the main interpreter, so
+ * the thread state of the interpreter the object was created in is used instead. Must be released with Homegear_releaseGil().
+ */
+static PyThreadState *Homegear_ensureGil(HomegearObject *self) {
+  auto startTime = std::chrono::steady_clock::now();
+  PyThreadState *threadState = self->threadStates->get();
+  PyEval_RestoreThread(threadState);
+  self->metrics->gilWaits.add(1);
+  self->metrics->gilWaitNanoseconds.add(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - startTime).count());
+  return threadState;
+}
+
+static void Homegear_releaseGil(PyThreadState *threadState) {
+  PyEval_ReleaseThread(threadState);
+}
+
+/**
+ * Calls a user callback and records the time spent in it.
+ */
+static PyObject *Homegear_callCallback(HomegearObject *self, PyObject *callback, PyObject *args) {
+  auto startTime = std::chrono::steady_clock::now();
+  PyObject *result = PyObject_Call(callback, args, nullptr);
+  self->metrics->callbacks.add(1);
+  self->metrics->callbackNanoseconds.add(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - startTime).count());
+  return result;
+}
+
+/**
+ * Called by the IPC thread every time the connection is established. Starts the replay of the offline queue, wakes up the threads waiting for the
+ * connection, resolves the futures returned by waitConnected() and calls the connect callback (in the event loop thread in asyncio mode).
+ */
+static void Homegear_onConnect(HomegearObject *self) {
+  if (self->offlineQueue) self->offlineQueue->replay();
+
+  std::vector<uint64_t> connectFutureIds;
+  {
+    std::lock_guard<std::mutex> waitGuard(*self->onConnectWaitMutex);
+    if (self->connectFutureIds) connectFutureIds.swap(*self->connectFutureIds);
+  }
+  self->onConnectConditionVariable->notify_all();
+
+  for (auto futureId : connectFutureIds) {
+    self->asyncBridge->complete(futureId, std::make_shared<Ipc::Variable>(true));
+  }
+
+  if (!self->connectCallback) return;
+  PyThreadState *threadState = Homegear_ensureGil(self);
+  PyObject *result = nullptr;
+  if (self->loop) result = PyObject_CallMethod(self->loop, "call_soon_threadsafe", "(O)", self->connectCallback);
+  else {
+    PyObject *args = PyTuple_New(0);
+    if (args) {
+      result = Homegear_callCallback(self, self->connectCallback, args);
+      Py_DECREF(args);
+    }
+  }
+  if (result) Py_DECREF(result);
+  else PyErr_WriteUnraisable(self->connectCallback);
+  Homegear_releaseGil(threadState);
+}
+
+/**
+ * Waits until the primary client is connected or the deadline is reached. Must be called without holding the GIL.
+ */
+static bool Homegear_waitForConnection(HomegearObject *self, std::chrono::steady_clock::time_point deadline) {
+  std::unique_lock<std::mutex> waitLock(*self->onConnectWaitMutex);
+  return self->onConnectConditionVariable->wait_until(waitLock, deadline, [&] { return self->ipcClient->connected(); });
+}
+
+static PyObject *Homegear_waitConnected(HomegearObject *self, PyObject *args, PyObject *kw) {
+  PyObject *timeoutObject = Py_None;
+  static const char *keywords[] = {"timeout", nullptr};
+  if (!PyArg_ParseTupleAndKeywords(args, kw, "|O:waitConnected", const_cast<char **>(keywords), &timeoutObject)) return nullptr;
+
+  if (self->asyncBridge) {
+    if (timeoutObject != Py_None) {
+      PyErr_SetString(PyExc_ValueError, "In asyncio mode, use asyncio.wait_for() for a timeout.");
+      return nullptr;
+    }
+    uint64_t futureId = 0;
+    PyObject *future = Homegear_addPendingFuture(self, futureId);
+    if (!future) return nullptr;
+    bool connected = false;
+    {
+      std::lock_guard<std::mutex> waitGuard(*self->onConnectWaitMutex);
+      connected = self->ipcClient->connected();
+      if (!connected) self->connectFutureIds->push_back(futureId);
+    }
+    if (connected) self->asyncBridge->complete(futureId, std::make_shared<Ipc::Variable>(true));
+    return future;
+  }
+
+  auto deadline = std::chrono::steady_clock::time_point::max();
+  if (timeoutObject != Py_None) {
+    double timeout = PyFloat_AsDouble(timeoutObject);
+    if (timeout == -1 && PyErr_Occurred()) return nullptr;
+    if (timeout < 0) {
+      PyErr_SetString(PyExc_ValueError, "Parameter timeout must not be negative.");
+      return nullptr;
+    }
+    deadline = std::chrono::steady_clock::now() + std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::duration<double>(timeout));
+  }
+
+  //Waits in slices, so signals like KeyboardInterrupt are handled while there is no connection.
+  while (true) {
+    auto sliceDeadline = std::min(deadline, std::chrono::steady_clock::now() + std::chrono::milliseconds(100));
+    bool connected = false;
+    Py_BEGIN_ALLOW_THREADS
+    connected = Homegear_waitForConnection(self, sliceDeadline);
+    Py_END_ALLOW_THREADS
+    if (connected) Py_RETURN_TRUE;
+    if (std::chrono::steady_clock::now() >= deadline) Py_RETURN_FALSE;
+    if (PyErr_CheckSignals() == -1) return nullptr;
+  }
+}
+
+static void Homegear_broadcastEvent(HomegearObject *self, std::string &eventSource, uint64_t peerId, int32_t channel, std::string &variableName, Ipc::PVariable value) {
+  if (!self->eventCallback) return;
+  PyThreadState *threadState = Homegear_ensureGil(self);
+  PyObject *pythonValue = self->converter->getPythonVariable(value, self->metrics->bytesToPython, self->binaryAsMemoryView);
+  PyObject *arglist = pythonValue ? Py_BuildValue("(NKiNN)", self->converter->getKey(eventSource), (unsigned long long)peerId, (int)channel, self->converter->getKey(variableName), pythonValue) : nullptr;
+  if (arglist == nullptr) {
+    PyErr_Clear();
+    Homegear_releaseGil(threadState);
+    return;
+  }
+  self->metrics->eventsDispatched.add(1);
+  PyObject *result = Homegear_callCallback(self, self->eventCallback, arglist);
+  Py_DECREF(arglist);
+  if (result == nullptr) {
+    Homegear_releaseGil(threadState);
+    return;
+  }
+  Py_DECREF(result);
+  Homegear_releaseGil(threadState);
+}
+
+static PyObject *Homegear_getEventDict(HomegearObject *self, const Ipc::PArray &variableNames, const Ipc::PArray &values) {
+  PyObject *eventDict = PyDict_New();
+  if (!eventDict) return nullptr;
+  for (size_t i = 0; i < variableNames->size() && i < values->size(); i++) {
+    PyObject *pythonValue = self->converter->getPythonVariable(values->at(i), self->metrics->bytesToPython, self->binaryAsMemoryView);
+    if (!pythonValue) {
+      Py_DECREF(eventDict);
+      return nullptr;
+    }
+    PyObject *key = self->converter->getKey(variableNames->at(i)->stringValue);
+    int result = key ? PyDict_SetItem(eventDict, key, pythonValue) : -1;
+    Py_XDECREF(key);
+    Py_DECREF(pythonValue);
+    if (result == -1) {
+      Py_DECREF(eventDict);
+      return nullptr;
+    }
+  }
+  return eventDict;
+}
+
+/**
+ * Converts the variables of one broadcastEvent. With batchEvents, one tuple containing a dict of all variables is created. Otherwise one tuple per variable.
+ */
+static void Homegear_getEventTuples(HomegearObject *self, uint64_t subscriptionId, const std::string &eventSource, uint64_t peerId, int32_t channel, const Ipc::PArray &variableNames, const Ipc::PArray &values, std::vector<std::pair<uint64_t, PyObject *>> &eventTuples) {
+  if (self->batchEvents) {
+    PyObject *eventDict = Homegear_getEventDict(self, variableNames, values);
+    PyObject *eventTuple = eventDict ? Py_BuildValue("(NKiN)", self->converter->getKey(eventSource), (unsigned long long)peerId, (int)channel, eventDict) : nullptr;
+    if (eventTuple) eventTuples.emplace_back(subscriptionId, eventTuple);
+    else PyErr_Clear();
+    return;
+  }
+
+  for (size_t i = 0; i < variableNames->size() && i < values->size(); i++) {
+    PyObject *pythonValue = self->converter->getPythonVariable(values->at(i), self->metrics->bytesToPython, self->binaryAsMemoryView);
+    PyObject *eventTuple = pythonValue ? Py_BuildValue("(NKiNN)", self->converter->getKey(eventSource), (unsigned long long)peerId, (int)channel, self->converter->getKey(variableNames->at(i)->stringValue), pythonValue) : nullptr;
+    if (eventTuple) eventTuples.emplace_back(subscriptionId, eventTuple);
+    else PyErr_Clear();
+  }
+}
+
+/**
+ * Converts events taken from the event queue. With batchEvents, consecutive events of the same channel are passed in one dict.
+ */
+static void Homegear_getQueuedEventTuples(HomegearObject *self, std::vector<EventQueue::Entry> &entries, std::vector<std::pair<uint64_t, PyObject *>> &eventTuples) {
+  if (!self->batchEvents) {
+    for (auto &entry : entries) {
+      PyObject *pythonValue = self->converter->getPythonVariable(entry.value, self->metrics->bytesToPython, self->binaryAsMemoryView);
+      PyObject *eventTuple = pythonValue ? Py_BuildValue("(NKiNN)", self->converter->getKey(entry.eventSource), (unsigned long long)entry.peerId, (int)entry.channel, self->converter->getKey(entry.variableName), pythonValue) : nullptr;
+      if (eventTuple) eventTuples.emplace_back(entry.subscriptionId, eventTuple);
+      else PyErr_Clear();
+    }
+    return;
+  }
+
+  PyObject *eventDict = nullptr;
+  EventQueue::Entry *firstEntry = nullptr;
+  for (size_t i = 0; i <= entries.size(); i++) {
+    auto entry = i < entries.size() ? &entries[i] : nullptr;
+    if (firstEntry && (!entry || entry->subscriptionId != firstEntry->subscriptionId || entry->peerId != firstEntry->peerId || entry->channel != firstEntry->channel || entry->eventSource != firstEntry->eventSource)) {
+      PyObject *eventTuple = Py_BuildValue("(NKiN)", self->converter->getKey(firstEntry->eventSource), (unsigned long long)firstEntry->peerId, (int)firstEntry->channel, eventDict);
+      if (eventTuple) eventTuples.emplace_back(firstEntry->subscriptionId, eventTuple);
+      else PyErr_Clear();
+      eventDict = nullptr;
+      firstEntry = nullptr;
+    }
+    if (!entry) break;
+
+    if (!eventDict) {
+      eventDict = PyDict_New();
+      if (!eventDict) {
+        PyErr_Clear();
+        continue;
+      }
+      firstEntry = entry;
+    }
+    PyObject *pythonValue = self->converter->getPythonVariable(entry->value, self->metrics->bytesToPython, self->binaryAsMemoryView);
+    PyObject *key = pythonValue ? self->converter->getKey(entry->variableName) : nullptr;
+    if (!key || PyDict_SetItem(eventDict, key, pythonValue) == -1) PyErr_Clear();
+    Py_XDECREF(key);
+    Py_XDECREF(pythonValue);
+  }
+}
+
+/**
+ * Returns a new reference to the event callback or to the callback of a subscription.
+ */
+static PyObject *Homegear_getEventCallback(HomegearObject *self, uint64_t subscriptionId) {
+  if (subscriptionId == 0) {
+    Py_XINCREF(self->eventCallback);
+    return self->eventCallback;
+  }
+  if (!self->subscriptions) return nullptr;
+  PyObject *key = PyLong_FromUnsignedLongLong(subscriptionId);
+  if (!key) {
+    PyErr_Clear();
+    return nullptr;
+  }
+  PyObject *callback = Homegear_getDictItem(self->subscriptions, key);
+  Py_DECREF(key);
+  return callback;
+}
+
+/**
+ * Calls the callback each event belongs to and releases the tuples.
+ */
+static void Homegear_callEventCallbacks(HomegearObject *self, std::vector<std::pair<uint64_t, PyObject *>> &eventTuples) {
+  for (auto &eventTuple : eventTuples) {
+    PyObject *callback = Homegear_getEventCallback(self, eventTuple.first);
+    if (callback) {
+      self->metrics->eventsDispatched.add(1);
+      PyObject *result = Homegear_callCallback(self, callback, eventTuple.second);
+      if (result) Py_DECREF(result);
+      else PyErr_WriteUnraisable(callback);
+      Py_DECREF(callback);
+    }
+    Py_DECREF(eventTuple.second);
+  }
+  eventTuples.clear();
+}
+
+/**
+ * Called once per broadcastEvent RPC and matching subscription (subscriptionId > 0) in asyncio mode, with the event queue, with dispatch workers or when
+ * batchEvents is set. Without queue, all variables are converted under a single GIL acquisition.
+ */
+static void Homegear_handleEvent(HomegearObject *self, uint64_t subscriptionId, std::string &eventSource, uint64_t peerId, int32_t channel, Ipc::PArray &variableNames, Ipc::PArray &values) {
+  //Events without subscription are only queued and converted when something consumes them.
+  if (subscriptionId == 0 && !self->eventCallback && !self->pullEvents && !self->hasEventStreams) return;
+
+  if (self->dispatchPool) {
+    //Sharded by peer ID, so the events of one device are passed to the callbacks in order. With the coalesce policy, a queued event with the same
+    //variables of the same channel is replaced.
+    uint64_t coalesceKey = std::hash<uint64_t>()(subscriptionId) ^ (std::hash<uint64_t>()(peerId) << 1) ^ (std::hash<int32_t>()(channel) << 2);
+    for (auto &variableName : *variableNames) {
+      coalesceKey ^= std::hash<std::string>()(variableName->stringValue) + 0x9e3779b97f4a7c15ull + (coalesceKey << 6) + (coalesceKey >> 2);
+    }
+    self->dispatchPool->push(peerId, [self, subscriptionId, eventSource, peerId, channel, variableNames, values]() {
+      std::vector<std::pair<uint64_t, PyObject *>> eventTuples;
+      Homegear_getEventTuples(self, subscriptionId, eventSource, peerId, channel, variableNames, values, eventTuples);
+      Homegear_callEventCallbacks(self, eventTuples);
+    }, coalesceKey | 1);
+    return;
+  }
+
+  if (self->eventQueue) {
+    self->eventQueue->push(subscriptionId, eventSource, peerId, channel, variableNames, values);
+    if (self->asyncBridge) self->asyncBridge->notify();
+    return;
+  }
+
+  if (self->asyncBridge) {
+    AsyncBridge::Event event;
+    event.subscriptionId = subscriptionId;
+    event.eventSource = eventSource;
+    event.peerId = peerId;
+    event.channel = channel;
+    event.variableNames = variableNames;
+    event.values = values;
+    self->asyncBridge->pushEvent(std::move(event));
+    return;
+  }
+
+  PyThreadState *threadState = Homegear_ensureGil(self);
+  std::vector<std::pair<uint64_t, PyObject *>> eventTuples;
+  Homegear_getEventTuples(self, subscriptionId, eventSource, peerId, channel, variableNames, values, eventTuples);
+  Homegear_callEventCallbacks(self, eventTuples);
+  Homegear_releaseGil(threadState);
+}
+
+/**
+ * Runs in its own thread when the event queue is enabled outside of asyncio mode, so slow callbacks don't block the IPC thread.
+ */
+static void Homegear_dispatchEvents(HomegearObject *self) {
+  std::vector<EventQueue::Entry> entries;
+  std::vector<std::pair<uint64_t, PyObject *>> eventTuples;
+  entries.reserve(kMaxDispatchBatch);
+  while (self->eventQueue->pop(entries, kMaxDispatchBatch, true)) {
+    PyThreadState *threadState = Homegear_ensureGil(self);
+    Homegear_getQueuedEventTuples(self, entries, eventTuples);
+    Homegear_callEventCallbacks(self, eventTuples);
+    Homegear_releaseGil(threadState);
+    entries.clear();
+  }
+}
+
+// {{{ Pull mode
+static PyObject *Homegear_fileno(HomegearObject *self, PyObject *unused) {
+  if (!self->pullEvents) {
+    PyErr_SetString(PyExc_RuntimeError, "fileno() is only available when \"pullEvents\" was set in the constructor.");
+    return nullptr;
+  }
+  return PyLong_FromLong(self->eventQueue->fileDescriptor());
+}
+
+/**
+ * Converts all queued events in one go. Events for the event callback are returned, events of subscriptions are passed to their callbacks.
+ */
+static PyObject *Homegear_drain(HomegearObject *self, PyObject *args, PyObject *kw) {
+  PyObject *maxEventsObject = Py_None;
+  static const char *keywords[] = {"maxEvents", nullptr};
+  if (!PyArg_ParseTupleAndKeywords(args, kw, "|O:drain", const_cast<char **>(keywords), &maxEventsObject)) return nullptr;
+  if (!self->pullEvents) {
+    PyErr_SetString(PyExc_RuntimeError, "drain() is only available when \"pullEvents\" was set in the constructor.");
+    return nullptr;
+  }
+  size_t maxEvents = SIZE_MAX;
+  if (maxEventsObject != Py_None) {
+    maxEvents = PyLong_AsSize_t(maxEventsObject);
+    if (maxEvents == (size_t)-1 && PyErr_Occurred()) return nullptr;
+  }
+
+  std::vector<EventQueue::Entry> entries;
+  self->eventQueue->pop(entries, maxEvents, false);
+  std::vector<std::pair<uint64_t, PyObject *>> eventTuples;
+  Homegear_getQueuedEventTuples(self, entries, eventTuples);
+
+  PyObject *events = PyList_New(0);
+  std::vector<std::pair<uint64_t, PyObject *>> subscriptionEventTuples;
+  for (auto &eventTuple : eventTuples) {
+    if (eventTuple.first != 0) {
+      subscriptionEventTuples.emplace_back(eventTuple);
+      continue;
+    }
+    if (events && PyList_Append(events, eventTuple.second) == -1) Py_CLEAR(events);
+    Py_DECREF(eventTuple.second);
+  }
+  if (events) self->metrics->eventsDispatched.add(PyList_GET_SIZE(events));
+  Homegear_callEventCallbacks(self, subscriptionEventTuples);
+  return events;
+}
+// }}}
+
+// {{{ Subscriptions
+/**
+ * Calls function for value itself if it is of the expected type or otherwise for all elements of value.
+ */
+static bool Homegear_forEachFilterValue(PyObject *value, const char *name, bool (*isSingleValue)(PyObject *), const std::function<bool(PyObject *)> &function) {
+  if (isSingleValue(value)) return function(value);
+
+  PyObject *iterator = PyObject_GetIter(value);
+  if (!iterator) {
+    PyErr_Format(PyExc_TypeError, "Parameter %s has an invalid type.", name);
+    return false;
+  }
+  PyObject *element = nullptr;
+  while ((element = PyIter_Next(iterator))) {
+    bool result = isSingleValue(element) && function(element);
+    Py_DECREF(element);
+    if (!result) {
+      if (!PyErr_Occurred()) PyErr_Format(PyExc_TypeError, "Parameter %s contains an element with an invalid type.", name);
+      Py_DECREF(iterator);
+      return false;
+    }
+  }
+  Py_DECREF(iterator);
+  return !PyErr_Occurred();
+}
+
+static bool Homegear_isLong(PyObject *value) { return PyLong_Check(value); }
+static bool Homegear_isUnicode(PyObject *value) { return PyUnicode_Check(value); }
+
+static PyObject *Homegear_subscribe(HomegearObject *self, PyObject *args, PyObject *kw) {
+  PyObject *callback = nullptr;
+  PyObject *peerIds = nullptr;
+  PyObject *channels = nullptr;
+  PyObject *variables = nullptr;
+  PyObject *eventSources = nullptr;
+  static const char *keywords[] = {"callback", "peerIds", "channels", "variables", "eventSources", nullptr};
+  if (!PyArg_ParseTupleAndKeywords(args, kw, "O|OOOO:subscribe", const_cast<char **>(keywords), &callback, &peerIds, &channels, &variables, &eventSources)) return nullptr;
+  if (!PyCallable_Check(callback)) {
+    PyErr_SetString(PyExc_TypeError, "Parameter callback must be callable.");
+    return nullptr;
+  }
+
+  auto filter = std::make_shared<EventFilter>();
+  if (peerIds && peerIds != Py_None) {
+    if (!Homegear_forEachFilterValue(peerIds, "peerIds", &Homegear_isLong, [&](PyObject *peerId) {
+      filter->addPeerId(PyLong_AsUnsignedLongLong(peerId));
+      return !PyErr_Occurred();
+    })) return nullptr;
+  }
+  if (channels && channels != Py_None) {
+    int minChannel = 0;
+    int maxChannel = 0;
+    if (PyLong_Check(channels)) {
+      minChannel = maxChannel = (int)PyLong_AsLong(channels);
+      if (PyErr_Occurred()) return nullptr;
+    } else if (!PyTuple_Check(channels) || !PyArg_ParseTuple(channels, "ii", &minChannel, &maxChannel)) {
+      PyErr_SetString(PyExc_TypeError, "Parameter channels must be a channel or a tuple (minChannel, maxChannel).");
+      return nullptr;
+    }
+    filter->setChannels(minChannel, maxChannel);
+  }
+  if (variables && variables != Py_None) {
+    if (!Homegear_forEachFilterValue(variables, "variables", &Homegear_isUnicode, [&](PyObject *variable) {
+      const char *variableName = PyUnicode_AsUTF8(variable);
+      if (variableName) filter->addVariable(variableName);
+      return variableName != nullptr;
+    })) return nullptr;
+  }
+  if (eventSources && eventSources != Py_None) {
+    if (!Homegear_forEachFilterValue(eventSources, "eventSources", &Homegear_isUnicode, [&](PyObject *eventSource) {
+      const char *eventSourceName = PyUnicode_AsUTF8(eventSource);
+      if (eventSourceName) filter->addEventSource(eventSourceName);
+      return eventSourceName != nullptr;
+    })) return nullptr;
+  }
+
+  uint64_t subscriptionId = self->ipcClient->addSubscription(filter);
+  PyObject *key = PyLong_FromUnsignedLongLong(subscriptionId);
+  if (!key || PyDict_SetItem(self->subscriptions, key, callback) == -1) {
+    self->ipcClient->removeSubscription(subscriptionId);
+    Py_XDECREF(key);
+    return nullptr;
+  }
+  return key;
+}
+
+static PyObject *Homegear_unsubscribe(HomegearObject *self, PyObject *args) {
+  unsigned long long subscriptionId = 0;
+  if (!PyArg_ParseTuple(args, "K:unsubscribe", &subscriptionId)) return nullptr;
+
+  bool removed = self->ipcClient->removeSubscription(subscriptionId);
+  PyObject *key = PyLong_FromUnsignedLongLong(subscriptionId);
+  if (!key) return nullptr;
+  if (PyDict_DelItem(self->subscriptions, key) == -1) PyErr_Clear();
+  Py_DECREF(key);
+
+  if (removed) Py_RETURN_TRUE;
+  Py_RETURN_FALSE;
+}
+// }}}
+
+static PyObject *Homegear_eventQueueStats(HomegearObject *self, PyObject *unused) {
+  if (self->dispatchPool) {
+    return Py_BuildValue("{s:n,s:n,s:K,s:K}",
+                         "size", (Py_ssize_t)self->dispatchPool->size(),
+                         "capacity", (Py_ssize_t)self->dispatchPool->capacity(),
+                         "dropped", (unsigned long long)self->dispatchPool->droppedCount(),
+                         "coalesced", (unsigned long long)self->dispatchPool->coalescedCount());
+  }
+
+  if (!self->eventQueue) {
+    PyErr_SetString(PyExc_RuntimeError, "The event queue is not enabled. Set \"eventQueueSize\" in the constructor.");
+    return nullptr;
+  }
+
+  return Py_BuildValue("{s:n,s:n,s:K,s:K}",
+                       "size", (Py_ssize_t)self->eventQueue->size(),
+                       "capacity", (Py_ssize_t)self->eventQueue->capacity(),
+                       "dropped", (unsigned long long)self->eventQueue->droppedCount(),
+                       "coalesced", (unsigned long long)self->eventQueue->coalescedCount());
+}
+
+static PyObject *Homegear_valueCacheStats(HomegearObject *self, PyObject *unused) {
+  if (!self->valueCache) {
+    PyErr_SetString(PyExc_RuntimeError, "The value cache is not enabled. Set \"valueCacheSize\" in the constructor.");
+    return nullptr;
+  }
+
+  return Py_BuildValue("{s:n,s:n,s:K,s:K}",
+                       "size", (Py_ssize_t)self->valueCache->size(),
+                       "capacity", (Py_ssize_t)self->valueCache->capacity(),
+                       "hits", (unsigned long long)self->valueCache->hitCount(),
+                       "misses", (unsigned long long)self->valueCache->missCount());
+}
+
+// {{{ Write buffer
+/**
+ * Called by the threads of the write buffer and the offline queue after each batch. Invalidates the written values in the value cache and passes failed writes to the write error
+ * callback.
+ */
+static void Homegear_handleWriteResults(HomegearObject *self, std::vector<WriteBuffer::Write> &writes, const Ipc::PVariable &result) {
+  if (self->valueCache) {
+    for (auto &write : writes) {
+      ValueCache::Key cacheKey;
+      bool clearAll = false;
+      if (!ValueCache::getWriteKey(write.methodName, write.parameters, cacheKey, clearAll)) continue;
+      if (clearAll) self->valueCache->clear();
+      else self->valueCache->invalidate(cacheKey);
+    }
+  }
+
+  if (!self->writeErrorCallback) return;
+  std::vector<std::pair<WriteBuffer::Write *, std::string>> errors;
+  for (size_t i = 0; i < writes.size(); i++) {
+    if (result->errorStruct) errors.emplace_back(&writes[i], Homegear_getFaultString(result));
+    else if (result->type != Ipc::VariableType::tArray) errors.emplace_back(&writes[i], "Invalid response to system.multicall.");
+    else if (i >= result->arrayValue->size()) errors.emplace_back(&writes[i], "No result was returned for the call.");
+    else if (result->arrayValue->at(i)->errorStruct) errors.emplace_back(&writes[i], Homegear_getFaultString(result->arrayValue->at(i)));
+  }
+  if (errors.empty()) return;
+
+  PyThreadState *threadState = Homegear_ensureGil(self);
+  for (auto &error : errors) {
+    PyObject *parameters = self->converter->getPythonVariable(std::make_shared<Ipc::Variable>(error.first->parameters), self->metrics->bytesToPython);
+    PyObject *args = parameters ? Py_BuildValue("(sNs)", error.first->methodName.c_str(), parameters, error.second.c_str()) : nullptr;
+    PyObject *callResult = args ? Homegear_callCallback(self, self->writeErrorCallback, args) : nullptr;
+    Py_XDECREF(args);
+    if (callResult) Py_DECREF(callResult);
+    else PyErr_WriteUnraisable(self->writeErrorCallback);
+  }
+  Homegear_releaseGil(threadState);
+}
+
+static PyObject *Homegear_flush(HomegearObject *self, PyObject *unused) {
+  if (!self->writeBuffer) {
+    PyErr_SetString(PyExc_RuntimeError, "The write buffer is not enabled. Set \"writeBehindInterval\" in the constructor.");
+    return nullptr;
+  }
+
+  bool flushed = false;
+  Py_BEGIN_ALLOW_THREADS
+  flushed = self->writeBuffer->flush();
+  Py_END_ALLOW_THREADS
+  if (flushed) Py_RETURN_TRUE;
+  else Py_RETURN_FALSE;
+}
+
+static PyObject *Homegear_writeBufferStats(HomegearObject *self, PyObject *unused) {
+  if (!self->writeBuffer) {
+    PyErr_SetString(PyExc_RuntimeError, "The write buffer is not enabled. Set \"writeBehindInterval\" in the constructor.");
+    return nullptr;
+  }
+
+  return Py_BuildValue("{s:n,s:K,s:K}",
+                       "size", (Py_ssize_t)self->writeBuffer->size(),
+                       "coalesced", (unsigned long long)self->writeBuffer->coalescedCount(),
+                       "sent", (unsigned long long)self->writeBuffer->sentCount());
+}
+
+static PyObject *Homegear_offlineQueueStats(HomegearObject *self, PyObject *unused) {
+  if (!self->offlineQueue) {
+    PyErr_SetString(PyExc_RuntimeError, "The offline queue is not enabled. Set \"offlineQueueSize\" in the constructor.");
+    return nullptr;
+  }
+
+  return Py_BuildValue("{s:n,s:K,s:K,s:K,s:K}",
+                       "size", (Py_ssize_t)self->offlineQueue->size(),
+                       "coalesced", (unsigned long long)self->offlineQueue->coalescedCount(),
+                       "spilled", (unsigned long long)self->offlineQueue->spilledCount(),
+                       "dropped", (unsigned long long)self->offlineQueue->droppedCount(),
+                       "replayed", (unsigned long long)self->offlineQueue->replayedCount());
+}
+// }}}
+
+/**
+ * Returns the upper bound in microseconds of the histogram bucket containing the passed percentile.
+ */
+static uint64_t Homegear_getLatencyPercentile(const Metrics::MethodStats::Snapshot &snapshot, double percentile) {
+  //The buckets are read after "calls", so concurrent calls might be counted in one but not the other. The rank is based on the buckets alone.
+  uint64_t total = 0;
+  for (auto bucket : snapshot.latencyBuckets) {
+    total += bucket;
+  }
+  auto rank = (uint64_t)std::ceil(total * percentile);
+  uint64_t count = 0;
+  for (size_t i = 0; i < Metrics::kLatencyBuckets; i++) {
+    count += snapshot.latencyBuckets[i];
+    if (count >= rank) return 1ull << i;
+  }
+  return 1ull << (Metrics::kLatencyBuckets - 1);
+}
+
+static PyObject *Homegear_stats(HomegearObject *self, PyObject *unused) {
+  double seconds = std::chrono::duration<double>(self->metrics->elapsed()).count();
+  if (seconds <= 0) seconds = 1e-9;
+
+  PyObject *methods = PyDict_New();
+  if (!methods) return nullptr;
+  for (auto &methodSnapshot : self->metrics->getMethodSnapshots()) {
+    auto &snapshot = methodSnapshot.second;
+    PyObject *histogram = PyList_New(Metrics::kLatencyBuckets);
+    if (!histogram) {
+      Py_DECREF(methods);
+      return nullptr;
+    }
+    for (size_t i = 0; i < Metrics::kLatencyBuckets; i++) {
+      PyList_SET_ITEM(histogram, i, PyLong_FromUnsignedLongLong(snapshot.latencyBuckets[i]));
+    }
+    PyObject *methodStats = Py_BuildValue("{s:K,s:K,s:d,s:K,s:K,s:N}",
+                                          "calls", (unsigned long long)snapshot.calls,
+                                          "errors", (unsigned long long)snapshot.errors,
+                                          "latencyAverageMicroseconds", (double)snapshot.latencySumNanoseconds / snapshot.calls / 1000.0,
+                                          "latencyP50Microseconds", (unsigned long long)Homegear_getLatencyPercentile(snapshot, 0.5),
+                                          "latencyP99Microseconds", (unsigned long long)Homegear_getLatencyPercentile(snapshot, 0.99),
+                                          "histogram", histogram);
+    if (!methodStats || PyDict_SetItemString(methods, methodSnapshot.first.c_str(), methodStats) == -1) {
+      Py_XDECREF(methodStats);
+      Py_DECREF(methods);
+      return nullptr;
+    }
+    Py_DECREF(methodStats);
+  }
+
+  uint64_t eventsReceived = self->metrics->eventsReceived.get();
+  uint64_t eventsFiltered = self->metrics->eventsFiltered.get();
+  uint64_t eventsDispatched = self->metrics->eventsDispatched.get();
+  uint64_t gilWaits = self->metrics->gilWaits.get();
+  uint64_t callbacks = self->metrics->callbacks.get();
+  return Py_BuildValue("{s:d,s:N,s:{s:K,s:K,s:K,s:d,s:d,s:d},s:{s:K,s:d,s:d},s:{s:K,s:d,s:d},s:{s:K,s:K}}",
+                       "seconds", seconds,
+                       "methods", methods,
+                       "events",
+                       "received", (unsigned long long)eventsReceived,
+                       "filtered", (unsigned long long)eventsFiltered,
+                       "dispatched", (unsigned long long)eventsDispatched,
+                       "receivedPerSecond", eventsReceived / seconds,
+                       "filteredPerSecond", eventsFiltered / seconds,
+                       "dispatchedPerSecond", eventsDispatched / seconds,
+                       "gil",
+                       "waits", (unsigned long long)gilWaits,
+                       "waitSeconds", self->metrics->gilWaitNanoseconds.get() / 1e9,
+                       "waitAverageMicroseconds", gilWaits ? self->metrics->gilWaitNanoseconds.get() / 1000.0 / gilWaits : 0.0,
+                       "callbacks",
+                       "calls", (unsigned long long)callbacks,
+                       "seconds", self->metrics->callbackNanoseconds.get() / 1e9,
+                       "averageMicroseconds", callbacks ? self->metrics->callbackNanoseconds.get() / 1000.0 / callbacks : 0.0,
+                       "conversion",
+                       "bytesToHomegear", (unsigned long long)self->metrics->bytesToHomegear.get(),
+                       "bytesToPython", (unsigned long long)self->metrics->bytesToPython->get());
+}
+
+static PyObject *Homegear_resetStats(HomegearObject *self, PyObject *unused) {
+  self->metrics->reset();
+  Py_RETURN_NONE;
+}
+
+/**
+ * Returns a new reference to the converted node info. Without lazyContainers, it is a new dict for every message, which the callback may modify. With
+ * lazyContainers, the node info is a read-only HomegearStruct. The node info of a node rarely changes, so the last converted object is then reused as
+ * long as the received node info is equal. The GIL must be held.
+ */
+static PyObject *Homegear_getNodeInfo(HomegearObject *self, const Ipc::PVariable &nodeInfo) {
+  if (!self->lazyContainers) return self->converter->getPythonVariable(nodeInfo, self->metrics->bytesToPython, self->binaryAsMemoryView);
+
+  {
+    std::lock_guard<std::mutex> nodeInfoGuard(*self->nodeInfoMutex);
+    if (self->nodeInfoObject && (*self->nodeInfo == nodeInfo || **self->nodeInfo == *nodeInfo)) {
+      Py_INCREF(self->nodeInfoObject);
+      return self->nodeInfoObject;
+    }
+  }
+
+  //Read-only, so callbacks can't change the object the following messages receive.
+  PyObject *nodeInfoObject = self->converter->getPythonVariable(nodeInfo, self->metrics->bytesToPython, self->binaryAsMemoryView, true);
+  if (!nodeInfoObject) return nullptr;
+  Py_INCREF(nodeInfoObject);
+  PyObject *oldNodeInfoObject = nullptr;
+  {
+    std::lock_guard<std::mutex> nodeInfoGuard(*self->nodeInfoMutex);
+    *self->nodeInfo = nodeInfo;
+    oldNodeInfoObject = self->nodeInfoObject;
+    self->nodeInfoObject = nodeInfoObject;
+  }
+  Py_XDECREF(oldNodeInfoObject); //Not within the lock, the destructor might release the GIL.
+  return nodeInfoObject;
+}
+
+/**
+ * Calls the node input callback. The GIL must be held.
+ */
+static void Homegear_callNodeInput(HomegearObject *self, const Ipc::PVariable &nodeInfo, uint32_t inputIndex, const Ipc::PVariable &message) {
+  PyObject *pythonNodeInfo = Homegear_getNodeInfo(self, nodeInfo);
+  PyObject *pythonMessage = self->converter->getPythonVariable(message, self->metrics->bytesToPython, self->binaryAsMemoryView);
+  if (pythonNodeInfo == nullptr || pythonMessage == nullptr) {
+    Py_XDECREF(pythonNodeInfo);
+    Py_XDECREF(pythonMessage);
+    PyErr_Clear();
+    return;
+  }
+  PyObject *arglist = Py_BuildValue("(NIN)", pythonNodeInfo, (unsigned int)inputIndex, pythonMessage);
+  if (arglist == nullptr) {
+    PyErr_Clear();
+    return;
+  }
+  PyObject *result = Homegear_callCallback(self, self->nodeInputCallback, arglist);
+  Py_DECREF(arglist);
+  if (result == nullptr) {
+    PyErr_Clear(); //Dispatch workers call several callbacks with the same thread state.
+    return;
+  }
+  Py_DECREF(result);
+}
+
+static void Homegear_nodeInput(HomegearObject *self, const Ipc::PVariable &nodeInfo, uint32_t inputIndex, const Ipc::PVariable &message) {
+  if (!self->nodeInputCallback) return;
+  if (self->dispatchPool) {
+    //Sharded by input, so the messages of one input are passed to the callback in order.
+    self->dispatchPool->push(inputIndex, [self, nodeInfo, inputIndex, message]() { Homegear_callNodeInput(self, nodeInfo, inputIndex, message); });
+    return;
+  }
+  PyThreadState *threadState = Homegear_ensureGil(self);
+  Homegear_callNodeInput(self, nodeInfo, inputIndex, message);
+  Homegear_releaseGil(threadState);
+}
+
+// {{{ Multicall
+/**
+ * Converts the result of "system.multicall". Successful calls are returned wrapped in an array of size 1, failed calls as fault struct.
+ */
+static PyObject *Homegear_getMulticallResult(HomegearObject *self, const Ipc::PVariable &result) {
+  if (result->type != Ipc::VariableType::tArray) {
+    PyErr_SetString(PyExc_Exception, "Invalid response to system.multicall.");
+    return nullptr;
+  }
+
+  auto &callResults = *result->arrayValue;
+  PyObject *output = PyList_New(callResults.size());
+  if (!output) return nullptr;
+  for (size_t i = 0; i < callResults.size(); i++) {
+    auto &callResult = callResults[i];
+    PyObject *value = nullptr;
+    if (callResult->type == Ipc::VariableType::tStruct && callResult->structValue->find("faultCode") != callResult->structValue->end()) {
+      auto faultStringIterator = callResult->structValue->find("faultString");
+      value = PyObject_CallFunction(PyExc_Exception, "s", faultStringIterator != callResult->structValue->end() ? faultStringIterator->second->stringValue.c_str() : "Unknown error.");
+    } else if (callResult->type == Ipc::VariableType::tArray && callResult->arrayValue->size() == 1) {
+      value = self->converter->getPythonVariable(callResult->arrayValue->front(), self->metrics->bytesToPython, self->binaryAsMemoryView, self->lazyContainers);
+    } else {
+      value = self->converter->getPythonVariable(callResult, self->metrics->bytesToPython, self->binaryAsMemoryView, self->lazyContainers);
+    }
+    if (!value) {
+      Py_DECREF(output);
+      return nullptr;
+    }
+    PyList_SET_ITEM(output, i, value);
+  }
+  return output;
+}
+
+/**
+ * Packs all calls into the parameters of one "system.multicall" request.
+ */
+static Ipc::PArray Homegear_getMulticallParameters(HomegearObject *self, PyObject *calls) {
+  PyObject *callSequence = PySequence_Fast(calls, "multicall() expects a list of calls.");
+  if (!callSequence) return Ipc::PArray();
+
+  auto callArray = std::make_shared<Ipc::Variable>(Ipc::VariableType::tArray);
+  Py_ssize_t callCount = PySequence_Fast_GET_SIZE(callSequence);
+  callArray->arrayValue->reserve(callCount);
+  for (Py_ssize_t i = 0; i < callCount; i++) {
+    PyObject *call = PySequence_Fast(PySequence_Fast_GET_ITEM(callSequence, i), "Each call must be a tuple or list of the method name followed by its parameters.");
+    if (!call) {
+      Py_DECREF(callSequence);
+      return Ipc::PArray();
+    }
+
+    Py_ssize_t callSize = PySequence_Fast_GET_SIZE(call);
+    PyObject **callItems = PySequence_Fast_ITEMS(call);
+    Py_ssize_t methodNameSize = 0;
+    const char *methodName = callSize > 0 && PyUnicode_Check(callItems[0]) ? PyUnicode_AsUTF8AndSize(callItems[0], &methodNameSize) : nullptr;
+    if (!methodName) {
+      if (!PyErr_Occurred()) PyErr_SetString(PyExc_TypeError, "The first element of each call must be the method name.");
+      Py_DECREF(call);
+      Py_DECREF(callSequence);
+      return Ipc::PArray();
+    }
+
+    auto callStruct = std::make_shared<Ipc::Variable>(Ipc::VariableType::tStruct);
+    std::string methodNameString(methodName, methodNameSize);
+    Ipc::PArray parameters;
+    if (kNodeMethods.find(methodNameString) != kNodeMethods.end()) {
+      if (!self->nodeIdVariable) {
+        PyErr_SetString(PyExc_Exception, "Node ID was not set in Object constructor.");
+        Py_DECREF(call);
+        Py_DECREF(callSequence);
+        return Ipc::PArray();
+      }
+      parameters = PythonVariableConverter::getArray(callItems + 1, callSize - 1, &self->metrics->bytesToHomegear, *self->nodeIdVariable);
+    } else parameters = PythonVariableConverter::getArray(callItems + 1, callSize - 1, &self->metrics->bytesToHomegear);
+    callStruct->structValue->emplace("methodName", std::make_shared<Ipc::Variable>(methodNameString));
+    callStruct->structValue->emplace("params", std::make_shared<Ipc::Variable>(parameters));
+    callArray->arrayValue->emplace_back(std::move(callStruct));
+    Py_DECREF(call);
+  }
+  Py_DECREF(callSequence);
+
+  auto parameters = std::make_shared<Ipc::Array>();
+  parameters->emplace_back(std::move(callArray));
+  return parameters;
+}
+
+/**
+ * Executes the parameters returned by Homegear_getMulticallParameters() or Homegear_nodeOutputMany() as "system.multicall".
+ */
+static PyObject *Homegear_invokeMulticall(HomegearObject *self, const Ipc::PArray &parameters) {
+  //Values written by any of the calls are invalidated once the multicall returns.
+  std::function<void(const Ipc::PVariable &result)> cacheHandler;
+  if (self->valueCache) {
+    auto valueCache = self->valueCache;
+    auto callArray = parameters->front()->arrayValue;
+    for (auto &call : *callArray) {
+      if (!ValueCache::isWriteMethod(call->structValue->at("methodName")->stringValue)) continue;
+      cacheHandler = [valueCache, callArray](const Ipc::PVariable &result) {
+        for (auto &call : *callArray) {
+          ValueCache::Key cacheKey;
+          bool clearAll = false;
+          if (!ValueCache::getWriteKey(call->structValue->at("methodName")->stringValue, call->structValue->at("params")->arrayValue, cacheKey, clearAll)) continue;
+          if (clearAll) valueCache->clear();
+          else valueCache->invalidate(cacheKey);
+        }
+      };
+      break;
+    }
+  }
+
+  auto stats = self->metrics->getMethodStats("system.multicall");
+  if (self->asyncBridge) return Homegear_invokeAsync(self, "system.multicall", parameters, HomegearResultKind::kMulticall, std::move(cacheHandler), stats);
+
+  Ipc::PVariable result;
+  Py_BEGIN_ALLOW_THREADS
+  result = self->ipcClientPool->invoke("system.multicall", parameters, stats);
+  if (cacheHandler) cacheHandler(result);
+  Py_END_ALLOW_THREADS
+
+  if (result->errorStruct) {
+    PyErr_SetString(PyExc_Exception, Homegear_getFaultString(result).c_str());
+    return nullptr;
+  }
+
+  return Homegear_getMulticallResult(self, result);
+}
 
-#if __GNUC__ > 7
-static PyTypeObject HomegearRpcMethodType = {
-    .ob_base = PyVarObject_HEAD_INIT(nullptr, 0)
-    .tp_name = "homegear.HomegearRpcMethod", // (module name, object name)
-    .tp_basicsize = sizeof(HomegearRpcMethodType),
-    .tp_dealloc = (destructor)HomegearRpcMethod_dealloc,
-    .tp_call = HomegearRpcMethod_call,
-    .tp_flags = Py_TPFLAGS_DEFAULT,
-    .tp_new = HomegearRpcMethod_new
-};
-#else
-static PyTypeObject HomegearRpcMethodType = {
-        PyVarObject_HEAD_INIT(nullptr, 0)
-        "homegear.HomegearRpcMethod",      // tp_name (module name, object name)
-        sizeof(HomegearRpcMethodType),     // tp_basicsize
-        0,                                 // tp_itemsize
-        (destructor)HomegearRpcMethod_dealloc, // tp_dealloc
-#if PY_MINOR_VERSION >= 8
-        0,                                 // tp_vectorcall_offset
-#else
-        nullptr,                           // tp_print
-#endif
-        nullptr,                           // tp_getattr
-        nullptr,                           // tp_setattr
-        nullptr,                           // tp_as_async
-        nullptr,                           // tp_repr
-        nullptr,                           // tp_as_number
-        nullptr,                           // tp_as_sequence
-        nullptr,                           // tp_as_mapping
-        nullptr,                           // tp_hash
-        HomegearRpcMethod_call,            // tp_call
-        nullptr,                           // tp_str
-        nullptr,                           // tp_getattro
-        nullptr,                           // tp_setattro
-        nullptr,                           // tp_as_buffer
-        Py_TPFLAGS_DEFAULT,                // tp_flags
-        nullptr,                           // tp_doc
-        nullptr,                           // tp_traverse
-        nullptr,                           // tp_clear
-        nullptr,                           // tp_richcompare
-        0,                                 // tp_weaklistoffset
-        nullptr,                           // tp_iter
-        nullptr,                           // tp_iternext
-        nullptr,                           // tp_methods
-        nullptr,                           // tp_members
-        nullptr,                           // tp_getset
-        nullptr,                           // tp_base
-        nullptr,                           // tp_dict
-        nullptr,                           // tp_descr_get
-        nullptr,                           // tp_descr_set
-        0,                                 // tp_dictoffset
-        nullptr,                           // tp_init
-        nullptr,                           // tp_alloc
-        HomegearRpcMethod_new,             // tp_new
-        nullptr,                           // tp_free
-#if PY_MINOR_VERSION >= 8
-        nullptr,                           // tp_is_gc
-#endif
-};
-#endif
+static PyObject *Homegear_multicall(HomegearObject *self, PyObject *calls) {
+  if (!self->ipcClient) Py_RETURN_NONE;
+  if (!self->asyncBridge && !self->ipcClient->connected()) Py_RETURN_NONE;
 
-static PyObject *HomegearRpcMethod_new(PyTypeObject *type, PyObject *arg, PyObject *kw) {
-  const char *methodName = nullptr;
+  auto parameters = Homegear_getMulticallParameters(self, calls);
+  if (!parameters) return nullptr;
 
-  switch (PyTuple_Size(arg)) {
-    case 1:if (!PyArg_ParseTuple(arg, "s", &methodName)) return nullptr;
+  //Writes still in the write buffer would otherwise be sent after the writes of the multicall and overwrite them.
+  if (self->writeBuffer && self->writeBuffer->size() > 0) {
+    for (auto &call : *parameters->front()->arrayValue) {
+      if (!WriteBuffer::isWriteMethod(call->structValue->at("methodName")->stringValue)) continue;
+      Py_BEGIN_ALLOW_THREADS
+      self->writeBuffer->flush();
+      Py_END_ALLOW_THREADS
       break;
-    default:return nullptr;
+    }
   }
 
-  if (!methodName) return nullptr;
-
-  auto self = (HomegearRpcMethod *)type->tp_alloc(type, type->tp_basicsize);
-  if (!self) return nullptr;
-  //Py_INCREF(self); //valgrind does not complain if we don't do this and the dealloc is only called after setting the object to "None".
-  self->methodName = new std::string(methodName);
-  self->ipcClient = nullptr;
-  self->nodeId = nullptr;
-
-  return (PyObject *)self;
+  return Homegear_invokeMulticall(self, parameters);
 }
 
-static void HomegearRpcMethod_dealloc(HomegearRpcMethod *self) {
-  if (self->methodName) {
-    delete self->methodName;
-    self->methodName = nullptr;
+/**
+ * Sends all messages to one output with a single "system.multicall". The node ID, the output index and the method name are converted once and shared
+ * by all calls.
+ */
+static PyObject *Homegear_nodeOutputMany(HomegearObject *self, PyObject *args) {
+  PyObject *outputIndex = nullptr;
+  PyObject *messages = nullptr;
+  if (!PyArg_ParseTuple(args, "OO:nodeOutputMany", &outputIndex, &messages)) return nullptr;
+  if (!PyLong_Check(outputIndex)) {
+    PyErr_SetString(PyExc_TypeError, "Parameter outputIndex must be an integer.");
+    return nullptr;
+  }
+  if (!self->nodeIdVariable) {
+    PyErr_SetString(PyExc_Exception, "Node ID was not set in Object constructor.");
+    return nullptr;
+  }
+  if (!self->ipcClient) Py_RETURN_NONE;
+  if (!self->asyncBridge && !self->ipcClient->connected()) Py_RETURN_NONE;
+
+  PyObject *messageSequence = PySequence_Fast(messages, "Parameter messages must be a list or tuple.");
+  if (!messageSequence) return nullptr;
+  Py_ssize_t messageCount = PySequence_Fast_GET_SIZE(messageSequence);
+  PyObject **messageItems = PySequence_Fast_ITEMS(messageSequence);
+
+  auto methodNameVariable = std::make_shared<Ipc::Variable>(std::string("nodeOutput"));
+  auto outputIndexVariable = PythonVariableConverter::getVariable(outputIndex, &self->metrics->bytesToHomegear);
+  auto callArray = std::make_shared<Ipc::Variable>(Ipc::VariableType::tArray);
+  callArray->arrayValue->reserve(messageCount);
+  for (Py_ssize_t i = 0; i < messageCount; i++) {
+    auto callParameters = std::make_shared<Ipc::Array>();
+    callParameters->reserve(3);
+    callParameters->emplace_back(*self->nodeIdVariable);
+    callParameters->emplace_back(outputIndexVariable);
+    callParameters->emplace_back(PythonVariableConverter::getVariable(messageItems[i], &self->metrics->bytesToHomegear));
+
+    auto callStruct = std::make_shared<Ipc::Variable>(Ipc::VariableType::tStruct);
+    callStruct->structValue->emplace("methodName", methodNameVariable);
+    callStruct->structValue->emplace("params", std::make_shared<Ipc::Variable>(callParameters));
+    callArray->arrayValue->emplace_back(std::move(callStruct));
   }
+  Py_DECREF(messageSequence);
 
-  Py_TYPE(self)->tp_free(self);
+  auto parameters = std::make_shared<Ipc::Array>();
+  parameters->emplace_back(std::move(callArray));
+  return Homegear_invokeMulticall(self, parameters);
 }
 
-static PyObject *HomegearRpcMethod_call(PyObject *object, PyObject *args, PyObject *kw) {
-  auto methodObject = (HomegearRpcMethod *)object;
+/**
+ * Writes the results of the "system.multicall" sent by getValueColumns() into contiguous columns. When all values are integers or booleans, the values
+ * are returned as int64 ("q"), otherwise as float64 ("d"). Failed calls and non-numeric values are 0 and marked as invalid. Only the two column
+ * objects are created, no Python object per value.
+ */
+static PyObject *Homegear_getValueColumnsResult(HomegearObject *self, const Ipc::PVariable &result, size_t keyCount) {
+  if (result->type != Ipc::VariableType::tArray || result->arrayValue->size() != keyCount) {
+    PyErr_SetString(PyExc_Exception, "Invalid response to system.multicall.");
+    return nullptr;
+  }
 
-  if (!methodObject->ipcClient) {
-    Py_RETURN_NONE;
+  auto &results = *result->arrayValue;
+  std::vector<Ipc::Variable *> values;
+  values.reserve(results.size());
+  bool isFloat = false;
+  for (auto &callResult : results) {
+    Ipc::Variable *value = nullptr;
+    if (!callResult->errorStruct && callResult->type == Ipc::VariableType::tArray && callResult->arrayValue->size() == 1) {
+      value = callResult->arrayValue->front().get();
+      if (value->type == Ipc::VariableType::tFloat) isFloat = true;
+      else if (value->type != Ipc::VariableType::tInteger && value->type != Ipc::VariableType::tInteger64 && value->type != Ipc::VariableType::tBoolean) value = nullptr;
+    }
+    values.push_back(value);
   }
 
-  if (*methodObject->methodName == "connected") {
-    if (methodObject->ipcClient->connected()) {
-      Py_RETURN_TRUE;
+  std::vector<char> valueData(values.size() * sizeof(int64_t));
+  std::vector<char> validData(values.size());
+  for (size_t i = 0; i < values.size(); i++) {
+    auto value = values[i];
+    if (!value) continue;
+    validData[i] = 1;
+    if (isFloat) {
+      double floatValue = value->type == Ipc::VariableType::tFloat ? value->floatValue : (value->type == Ipc::VariableType::tBoolean ? (double)value->booleanValue : (double)value->integerValue64);
+      memcpy(valueData.data() + i * sizeof(double), &floatValue, sizeof(double));
     } else {
-      Py_RETURN_FALSE;
+      int64_t integerValue = value->type == Ipc::VariableType::tBoolean ? (int64_t)value->booleanValue : value->integerValue64;
+      memcpy(valueData.data() + i * sizeof(int64_t), &integerValue, sizeof(int64_t));
     }
   }
 
-  if (!methodObject->ipcClient->connected()) Py_RETURN_NONE;
-
-  auto parameters = PythonVariableConverter::getVariable(args);
+  PyObject *valueColumn = self->converter->getColumn(std::move(valueData), isFloat ? "d" : "q", sizeof(int64_t));
+  PyObject *validColumn = self->converter->getColumn(std::move(validData), "?", 1);
+  if (!valueColumn || !validColumn) {
+    Py_XDECREF(valueColumn);
+    Py_XDECREF(validColumn);
+    return nullptr;
+  }
+  return Py_BuildValue("(NN)", valueColumn, validColumn);
+}
 
-  auto nodeMethodIterator = kNodeMethods.find(*methodObject->methodName);
-  if (nodeMethodIterator != kNodeMethods.end()) {
-    if (!methodObject->nodeId || methodObject->nodeId->empty()) {
-      PyErr_SetString(PyExc_Exception, "Node ID was not set in Object constructor.");
+/**
+ * Reads many values with one "system.multicall" of getValue() calls. The method name is converted once and shared by all calls.
+ */
+static PyObject *Homegear_getValueColumns(HomegearObject *self, PyObject *keys) {
+  if (!self->ipcClient) Py_RETURN_NONE;
+  if (!self->asyncBridge && !self->ipcClient->connected()) Py_RETURN_NONE;
+
+  PyObject *keySequence = PySequence_Fast(keys, "Parameter keys must be a list or tuple.");
+  if (!keySequence) return nullptr;
+  Py_ssize_t keyCount = PySequence_Fast_GET_SIZE(keySequence);
+  PyObject **keyItems = PySequence_Fast_ITEMS(keySequence);
+
+  auto methodNameVariable = std::make_shared<Ipc::Variable>(std::string("getValue"));
+  auto callArray = std::make_shared<Ipc::Variable>(Ipc::VariableType::tArray);
+  callArray->arrayValue->reserve(keyCount);
+  for (Py_ssize_t i = 0; i < keyCount; i++) {
+    PyObject *key = PySequence_Fast(keyItems[i], "Each key must be a tuple of peer ID, channel and variable name.");
+    if (!key) {
+      Py_DECREF(keySequence);
       return nullptr;
     }
-
-    auto newParameters = std::make_shared<Ipc::Array>();
-    newParameters->reserve(parameters->arrayValue->size() + 1);
-    newParameters->emplace_back(std::make_shared<Ipc::Variable>(*methodObject->nodeId));
-    newParameters->insert(newParameters->end(), parameters->arrayValue->begin(), parameters->arrayValue->end());
-
-    auto result = methodObject->ipcClient->invoke(*methodObject->methodName, newParameters);
-    if (result->errorStruct) {
-      PyErr_SetString(PyExc_Exception, result->structValue->at("faultString")->stringValue.c_str());
+    if (PySequence_Fast_GET_SIZE(key) != 3) {
+      PyErr_SetString(PyExc_ValueError, "Each key must be a tuple of peer ID, channel and variable name.");
+      Py_DECREF(key);
+      Py_DECREF(keySequence);
       return nullptr;
     }
 
-    return PythonVariableConverter::getPythonVariable(result);
-  } else {
-    auto result = methodObject->ipcClient->invoke(*methodObject->methodName, parameters->arrayValue);
-    if (result->errorStruct) {
-      PyErr_SetString(PyExc_Exception, result->structValue->at("faultString")->stringValue.c_str());
+    auto callStruct = std::make_shared<Ipc::Variable>(Ipc::VariableType::tStruct);
+    callStruct->structValue->emplace("methodName", methodNameVariable);
+    callStruct->structValue->emplace("params", std::make_shared<Ipc::Variable>(PythonVariableConverter::getArray(PySequence_Fast_ITEMS(key), 3, &self->metrics->bytesToHomegear)));
+    callArray->arrayValue->emplace_back(std::move(callStruct));
+    Py_DECREF(key);
+  }
+  Py_DECREF(keySequence);
+
+  auto parameters = std::make_shared<Ipc::Array>();
+  parameters->emplace_back(std::move(callArray));
+
+  auto stats = self->metrics->getMethodStats("getValueColumns");
+  if (self->asyncBridge) return Homegear_invokeAsync(self, "system.multicall", parameters, HomegearResultKind::kValueColumns, std::function<void(const Ipc::PVariable &result)>(), stats, (size_t)keyCount);
+
+  Ipc::PVariable result;
+  Py_BEGIN_ALLOW_THREADS
+  result = self->ipcClientPool->invoke("system.multicall", parameters, stats);
+  Py_END_ALLOW_THREADS
+
+  if (result->errorStruct) {
+    PyErr_SetString(PyExc_Exception, Homegear_getFaultString(result).c_str());
+    return nullptr;
+  }
+
+  return Homegear_getValueColumnsResult(self, result, (size_t)keyCount);
+}
+// }}}
+
+// {{{ Streaming results
+/**
+ * Wraps the result in a HomegearResultIterator. The iterator takes over the result, nobody else may reference it.
+ */
+static PyObject *Homegear_getResultIterator(HomegearObject *self, const Ipc::PVariable &result) {
+  if (result->type != Ipc::VariableType::tArray && result->type != Ipc::VariableType::tStruct && result->type != Ipc::VariableType::tVoid) {
+    PyErr_SetString(PyExc_TypeError, "The result is neither an array nor a struct.");
+    return nullptr;
+  }
+  auto type = (PyTypeObject *)self->moduleState->resultIteratorType;
+  auto iterator = (HomegearResultIterator *)type->tp_alloc(type, 0);
+  if (!iterator) return nullptr;
+  iterator->converter = self->converter;
+  iterator->result = new Ipc::PVariable(result);
+  iterator->byteCounter = new std::shared_ptr<Metrics::Counter>(self->metrics->bytesToPython);
+  iterator->binaryAsMemoryView = self->binaryAsMemoryView;
+  iterator->lazyContainers = self->lazyContainers;
+  return (PyObject *)iterator;
+}
+
+static PyObject *Homegear_iter(HomegearObject *self, PyObject *args) {
+  Py_ssize_t argCount = PyTuple_GET_SIZE(args);
+  Py_ssize_t methodNameSize = 0;
+  const char *methodName = argCount > 0 && PyUnicode_Check(PyTuple_GET_ITEM(args, 0)) ? PyUnicode_AsUTF8AndSize(PyTuple_GET_ITEM(args, 0), &methodNameSize) : nullptr;
+  if (!methodName) {
+    if (!PyErr_Occurred()) PyErr_SetString(PyExc_TypeError, "The first parameter must be the method name.");
+    return nullptr;
+  }
+  std::string methodNameString(methodName, methodNameSize);
+
+  Ipc::PArray parameters;
+  PyObject **argItems = &PyTuple_GET_ITEM(args, 0);
+  if (kNodeMethods.find(methodNameString) != kNodeMethods.end()) {
+    if (!self->nodeIdVariable) {
+      PyErr_SetString(PyExc_Exception, "Node ID was not set in Object constructor.");
       return nullptr;
     }
+    parameters = PythonVariableConverter::getArray(argItems + 1, argCount - 1, &self->metrics->bytesToHomegear, *self->nodeIdVariable);
+  } else parameters = PythonVariableConverter::getArray(argItems + 1, argCount - 1, &self->metrics->bytesToHomegear);
+
+  auto stats = self->metrics->getMethodStats(methodNameString);
+  if (self->asyncBridge) return Homegear_invokeAsync(self, methodNameString, parameters, HomegearResultKind::kIterator, std::function<void(const Ipc::PVariable &result)>(), stats);
 
-    return PythonVariableConverter::getPythonVariable(result);
+  Ipc::PVariable result;
+  if (self->ipcClient && self->ipcClient->connected()) {
+    Py_BEGIN_ALLOW_THREADS
+    result = self->ipcClientPool->invoke(methodNameString, parameters, stats);
+    Py_END_ALLOW_THREADS
+  } else result = std::make_shared<Ipc::Variable>();
+
+  if (result->errorStruct) {
+    PyErr_SetString(PyExc_Exception, Homegear_getFaultString(result).c_str());
+    return nullptr;
   }
+
+  return Homegear_getResultIterator(self, result);
 }
+// }}}
 
-static void Homegear_onConnect(HomegearObject *self) {
-  std::unique_lock<std::mutex> waitLock(*self->onConnectWaitMutex);
-  waitLock.unlock();
-  self->onConnectConditionVariable->notify_all();
+// {{{ asyncio mode
+/**
+ * Creates a future, which is resolved by Homegear_processAsyncResults() when the AsyncBridge returns a result with the ID written to futureId.
+ */
+static PyObject *Homegear_addPendingFuture(HomegearObject *self, uint64_t &futureId) {
+  if (!self->loop || !self->pendingFutures) {
+    PyErr_SetString(PyExc_RuntimeError, "The event loop of this object was released.");
+    return nullptr;
+  }
+  PyObject *future = PyObject_CallMethod(self->loop, "create_future", nullptr);
+  if (!future) return nullptr;
+  {
+    std::lock_guard<std::mutex> futureGuard(*self->futureMutex);
+    futureId = ++self->currentFutureId;
+  }
+  PyObject *key = PyLong_FromUnsignedLongLong(futureId);
+  if (!key || PyDict_SetItem(self->pendingFutures, key, future) == -1) {
+    Py_XDECREF(key);
+    Py_DECREF(future);
+    return nullptr;
+  }
+  Py_DECREF(key);
+  return future;
 }
 
-static void Homegear_broadcastEvent(HomegearObject *self, std::string &eventSource, uint64_t peerId, int32_t channel, std::string &variableName, Ipc::PVariable value) {
-  if (!self->eventCallback) return;
-  PyGILState_STATE gstate;
-  gstate = PyGILState_Ensure();
-  PyObject *pythonValue = PythonVariableConverter::getPythonVariable(value);
-  if (pythonValue == nullptr) return;
-  PyObject *arglist = Py_BuildValue("(sKisO)", eventSource.c_str(), (unsigned long long)peerId, (int)channel, variableName.c_str(), pythonValue);
-  if (arglist == nullptr) {
-    Py_DECREF(pythonValue);
-    PyGILState_Release(gstate);
-    return;
+/**
+ * Executes the call in one of the bridge's worker threads. The returned future is resolved by Homegear_processAsyncResults() in the event loop thread.
+ */
+static PyObject *Homegear_invokeAsync(HomegearObject *self, const std::string &methodName, const Ipc::PArray &parameters, HomegearResultKind resultKind, std::function<void(const Ipc::PVariable &result)> resultHandler, Metrics::MethodStats *stats, size_t expectedSize) {
+  uint64_t futureId = 0;
+  PyObject *future = Homegear_addPendingFuture(self, futureId);
+  if (!future) return nullptr;
+  if (resultKind != HomegearResultKind::kDefault) {
+    std::lock_guard<std::mutex> futureGuard(*self->futureMutex);
+    self->futureResultKinds->emplace(futureId, HomegearFutureResult{resultKind, expectedSize});
   }
-  PyObject *result = PyObject_Call(self->eventCallback, arglist, nullptr);
-  Py_DECREF(arglist);
-  Py_DECREF(pythonValue);
-  if (result == nullptr) {
-    PyGILState_Release(gstate);
-    return;
+  self->asyncBridge->invoke(futureId, methodName, parameters, std::move(resultHandler), stats);
+  return future;
+}
+
+/**
+ * Returns a future which already has the result set. Steals the reference to value.
+ */
+static PyObject *Homegear_getResolvedFuture(HomegearObject *self, PyObject *value) {
+  if (!self->loop) {
+    Py_DECREF(value);
+    PyErr_SetString(PyExc_RuntimeError, "The event loop of this object was released.");
+    return nullptr;
   }
-  Py_DECREF(result);
-  PyGILState_Release(gstate);
+  PyObject *future = PyObject_CallMethod(self->loop, "create_future", nullptr);
+  PyObject *callResult = future ? PyObject_CallMethod(future, "set_result", "(O)", value) : nullptr;
+  Py_DECREF(value);
+  if (!callResult) {
+    Py_XDECREF(future);
+    return nullptr;
+  }
+  Py_DECREF(callResult);
+  return future;
 }
 
-static void Homegear_nodeInput(HomegearObject *self, const Ipc::PVariable &nodeInfo, uint32_t inputIndex, const Ipc::PVariable &message) {
-  if (!self->nodeInputCallback) return;
-  PyGILState_STATE gstate;
-  gstate = PyGILState_Ensure();
-  PyObject *pythonNodeInfo = PythonVariableConverter::getPythonVariable(nodeInfo);
-  PyObject *pythonMessage = PythonVariableConverter::getPythonVariable(message);
-  if (nodeInfo == nullptr || pythonMessage == nullptr) return;
-  PyObject *arglist = Py_BuildValue("(OIO)", pythonNodeInfo, (unsigned int)inputIndex, pythonMessage);
-  if (arglist == nullptr) {
-    Py_DECREF(pythonNodeInfo);
-    Py_DECREF(pythonMessage);
-    PyGILState_Release(gstate);
+static void Homegear_resolveFuture(HomegearObject *self, PyObject *future, const Ipc::PVariable &result, const HomegearFutureResult &futureResult) {
+  auto resultKind = futureResult.kind;
+  PyObject *cancelled = PyObject_CallMethod(future, "cancelled", nullptr);
+  if (!cancelled) {
+    PyErr_WriteUnraisable(future);
     return;
   }
-  PyObject *result = PyObject_Call(self->nodeInputCallback, arglist, nullptr);
-  Py_DECREF(arglist);
-  Py_DECREF(pythonNodeInfo);
-  Py_DECREF(pythonMessage);
-  if (result == nullptr) {
-    PyGILState_Release(gstate);
+  bool isCancelled = PyObject_IsTrue(cancelled) == 1;
+  Py_DECREF(cancelled);
+  if (isCancelled) return;
+
+  PyObject *callResult = nullptr;
+  if (result->errorStruct) {
+    PyObject *exception = PyObject_CallFunction(PyExc_Exception, "s", Homegear_getFaultString(result).c_str());
+    if (exception) {
+      callResult = PyObject_CallMethod(future, "set_exception", "(O)", exception);
+      Py_DECREF(exception);
+    }
+  } else {
+    PyObject *value = nullptr;
+    if (resultKind == HomegearResultKind::kMulticall) value = Homegear_getMulticallResult(self, result);
+    else if (resultKind == HomegearResultKind::kValueColumns) value = Homegear_getValueColumnsResult(self, result, futureResult.expectedSize);
+    else if (resultKind == HomegearResultKind::kIterator) value = Homegear_getResultIterator(self, result);
+    else value = self->converter->getPythonVariable(result, self->metrics->bytesToPython, self->binaryAsMemoryView, self->lazyContainers);
+    if (value) {
+      callResult = PyObject_CallMethod(future, "set_result", "(O)", value);
+      Py_DECREF(value);
+    } else if (resultKind != HomegearResultKind::kDefault) {
+      PyObject *type = nullptr, *exception = nullptr, *traceback = nullptr;
+      PyErr_Fetch(&type, &exception, &traceback);
+      PyErr_NormalizeException(&type, &exception, &traceback);
+      if (exception) callResult = PyObject_CallMethod(future, "set_exception", "(O)", exception);
+      Py_XDECREF(type);
+      Py_XDECREF(exception);
+      Py_XDECREF(traceback);
+    }
+  }
+
+  if (callResult) Py_DECREF(callResult);
+  else PyErr_WriteUnraisable(future);
+}
+
+static void Homegear_processAsyncResults(HomegearObject *self) {
+  if (!self->pendingFutures || !self->eventStreams) return;
+  std::vector<AsyncBridge::Completion> completions;
+  std::vector<AsyncBridge::Event> events;
+  self->asyncBridge->collect(completions, events);
+
+  for (auto &completion : completions) {
+    PyObject *key = PyLong_FromUnsignedLongLong(completion.id);
+    if (!key) {
+      PyErr_Clear();
+      continue;
+    }
+    PyObject *future = Homegear_popDictItem(self->pendingFutures, key);
+    if (future) {
+      HomegearFutureResult futureResult;
+      {
+        std::lock_guard<std::mutex> futureGuard(*self->futureMutex);
+        auto resultKindIterator = self->futureResultKinds->find(completion.id);
+        if (resultKindIterator != self->futureResultKinds->end()) {
+          futureResult = resultKindIterator->second;
+          self->futureResultKinds->erase(resultKindIterator);
+        }
+      }
+      Homegear_resolveFuture(self, future, completion.result, futureResult);
+      Py_DECREF(future);
+    }
+    Py_DECREF(key);
+  }
+
+  std::vector<std::pair<uint64_t, PyObject *>> eventTuples;
+  if (self->eventQueue) {
+    std::vector<EventQueue::Entry> entries;
+    self->eventQueue->pop(entries, SIZE_MAX, false);
+    Homegear_getQueuedEventTuples(self, entries, eventTuples);
+  }
+
+  for (auto &event : events) {
+    Homegear_getEventTuples(self, event.subscriptionId, event.eventSource, event.peerId, event.channel, event.variableNames, event.values, eventTuples);
+  }
+
+  if (eventTuples.empty()) return;
+
+  std::vector<HomegearEventStream *> streams; //Strong references
+  PyObject *liveStreams = PyList_New(0);
+  if (!liveStreams) {
+    PyErr_Clear();
+    Homegear_callEventCallbacks(self, eventTuples);
     return;
   }
-  Py_DECREF(result);
-  PyGILState_Release(gstate);
+  for (Py_ssize_t i = 0; i < PyList_GET_SIZE(self->eventStreams); i++) {
+    PyObject *reference = PyList_GET_ITEM(self->eventStreams, i);
+    PyObject *stream = Homegear_getWeakReferenceObject(reference);
+    if (!stream) continue;
+    streams.push_back((HomegearEventStream *)stream);
+    PyList_Append(liveStreams, reference);
+  }
+  Py_SETREF(self->eventStreams, liveStreams);
+  self->hasEventStreams = !streams.empty();
+
+  for (auto &eventTuple : eventTuples) {
+    if (eventTuple.first != 0) continue; //Streams receive all events, subscriptions only have a callback.
+    for (auto stream : streams) {
+      HomegearEventStream_push(stream, eventTuple.second);
+    }
+    self->metrics->eventsDispatched.add(streams.size());
+  }
+  for (auto stream : streams) {
+    Py_DECREF(stream);
+  }
+
+  Homegear_callEventCallbacks(self, eventTuples);
+}
+
+static PyObject *Homegear_asyncReadable(PyObject *weakSelf, PyObject *unused) {
+  PyObject *object = Homegear_getWeakReferenceObject(weakSelf);
+  if (!object) Py_RETURN_NONE;
+  Homegear_processAsyncResults((HomegearObject *)object);
+  Py_DECREF(object);
+  Py_RETURN_NONE;
+}
+
+static PyMethodDef HomegearAsyncReadableMethod = {"asyncReadable", (PyCFunction)Homegear_asyncReadable, METH_NOARGS, nullptr};
+
+static PyObject *Homegear_events(HomegearObject *self, PyObject *unused) {
+  if (!self->asyncBridge) {
+    PyErr_SetString(PyExc_RuntimeError, "events() is only available when an event loop was passed to the constructor.");
+    return nullptr;
+  }
+  if (!self->loop || !self->eventStreams) {
+    PyErr_SetString(PyExc_RuntimeError, "The event loop of this object was released.");
+    return nullptr;
+  }
+
+  auto stream = PyObject_GC_New(HomegearEventStream, (PyTypeObject *)self->moduleState->eventStreamType);
+  if (!stream) return nullptr;
+  stream->loop = nullptr;
+  stream->waiter = nullptr;
+  stream->weakReferences = nullptr;
+  stream->events = new std::deque<PyObject *>();
+  Py_INCREF(self->loop);
+  stream->loop = self->loop;
+  PyObject_GC_Track(stream);
+
+  PyObject *reference = PyWeakref_NewRef((PyObject *)stream, nullptr);
+  if (!reference || PyList_Append(self->eventStreams, reference) == -1) {
+    Py_XDECREF(reference);
+    Py_DECREF(stream);
+    return nullptr;
+  }
+  Py_DECREF(reference);
+  self->hasEventStreams = true;
+
+  return (PyObject *)stream;
 }
+// }}}
 
 static PyObject *Homegear_new(PyTypeObject *type, PyObject *arg, PyObject *kw) {
   const char *socketPath = nullptr;
@@ -365,7 +2160,6 @@ static PyObject *Homegear_new(PyTypeObject *type, PyObject *arg, PyObject *kw) {
         PyErr_SetString(PyExc_TypeError, "Parameter eventCallback must be callable.");
         return nullptr;
       }
-      Py_XINCREF(tempEventCallback);         /* Add a reference to new callback */
       break;
     }
     case 4: {
@@ -374,13 +2168,11 @@ static PyObject *Homegear_new(PyTypeObject *type, PyObject *arg, PyObject *kw) {
         PyErr_SetString(PyExc_TypeError, "Parameter eventCallback must be callable.");
         return nullptr;
       }
-      Py_XINCREF(tempEventCallback);         /* Add a reference to new callback */
 
       if (!PyCallable_Check(tempNodeInputCallback)) {
         PyErr_SetString(PyExc_TypeError, "Parameter nodeInputCallback must be callable.");
         return nullptr;
       }
-      Py_XINCREF(tempNodeInputCallback);         /* Add a reference to new callback */
       break;
     }
     default: {
@@ -390,19 +2182,160 @@ static PyObject *Homegear_new(PyTypeObject *type, PyObject *arg, PyObject *kw) {
 
   if (!socketPath) return nullptr;
 
+  PyObject *loop = nullptr;
+  unsigned int asyncWorkers = 4;
+  int batchEvents = 0;
+  int binaryAsMemoryView = 0;
+  int lazyContainers = 0;
+  int pullEvents = 0;
+  double writeBehindInterval = 0;
+  PyObject *writeErrorCallback = nullptr;
+  unsigned int offlineQueueSize = 0;
+  const char *offlineQueueFile = nullptr;
+  unsigned int eventQueueSize = 0;
+  unsigned int valueCacheSize = 0;
+  unsigned int connections = 1;
+  unsigned int dispatchWorkers = 0;
+  double connectTimeout = 2;
+  PyObject *connectCallback = nullptr;
+  const char *eventQueuePolicyName = "dropOldest"; //The IPC thread must not wait for Python by default, it also delivers the responses
+  EventQueue::OverflowPolicy eventQueuePolicy = EventQueue::OverflowPolicy::kDropOldest;
+  if (kw) {
+    static const char *keywords[] = {"loop", "asyncWorkers", "batchEvents", "eventQueueSize", "eventQueuePolicy", "binaryAsMemoryView", "valueCacheSize", "connections", "dispatchWorkers", "connectTimeout", "connectCallback", "lazyContainers", "pullEvents", "writeBehindInterval", "writeErrorCallback", "offlineQueueSize", "offlineQueueFile", nullptr};
+    PyObject *emptyTuple = PyTuple_New(0);
+    if (!emptyTuple) return nullptr;
+    int parseResult = PyArg_ParseTupleAndKeywords(emptyTuple, kw, "|$OIpIspIIIdOppdOIz:Homegear_new", const_cast<char **>(keywords), &loop, &asyncWorkers, &batchEvents, &eventQueueSize, &eventQueuePolicyName, &binaryAsMemoryView, &valueCacheSize, &connections, &dispatchWorkers, &connectTimeout, &connectCallback, &lazyContainers, &pullEvents, &writeBehindInterval, &writeErrorCallback, &offlineQueueSize, &offlineQueueFile);
+    Py_DECREF(emptyTuple);
+    if (!parseResult) return nullptr;
+    if (loop == Py_None) loop = nullptr;
+    if (!EventQueue::getPolicy(eventQueuePolicyName, eventQueuePolicy)) {
+      PyErr_SetString(PyExc_ValueError, "Parameter eventQueuePolicy must be \"block\", \"dropOldest\" or \"coalesce\".");
+      return nullptr;
+    }
+    if (connections == 0) {
+      PyErr_SetString(PyExc_ValueError, "Parameter connections must be at least 1.");
+      return nullptr;
+    }
+    if (connectCallback == Py_None) connectCallback = nullptr;
+    if (connectCallback && !PyCallable_Check(connectCallback)) {
+      PyErr_SetString(PyExc_TypeError, "Parameter connectCallback must be callable.");
+      return nullptr;
+    }
+    if (writeErrorCallback == Py_None) writeErrorCallback = nullptr;
+    if (writeErrorCallback && !PyCallable_Check(writeErrorCallback)) {
+      PyErr_SetString(PyExc_TypeError, "Parameter writeErrorCallback must be callable.");
+      return nullptr;
+    }
+    if (writeBehindInterval < 0) {
+      PyErr_SetString(PyExc_ValueError, "Parameter writeBehindInterval must not be negative.");
+      return nullptr;
+    }
+    if (offlineQueueFile && offlineQueueSize == 0) {
+      PyErr_SetString(PyExc_ValueError, "Parameter offlineQueueFile requires offlineQueueSize.");
+      return nullptr;
+    }
+    if (offlineQueueSize > 0 && writeBehindInterval > 0) {
+      //The write buffer keeps its writes while disconnected. They would be sent after the replayed writes and overwrite newer values.
+      PyErr_SetString(PyExc_ValueError, "Parameter offlineQueueSize can't be combined with writeBehindInterval.");
+      return nullptr;
+    }
+    if (connectTimeout < 0) {
+      PyErr_SetString(PyExc_ValueError, "Parameter connectTimeout must not be negative.");
+      return nullptr;
+    }
+    if (pullEvents && (loop || dispatchWorkers > 0)) {
+      PyErr_SetString(PyExc_ValueError, "Parameter pullEvents can't be combined with loop or dispatchWorkers.");
+      return nullptr;
+    }
+    if (pullEvents && eventQueueSize == 0) eventQueueSize = kPullEventQueueSize;
+    if (dispatchWorkers > 0 && (loop || eventQueueSize > 0)) {
+      PyErr_SetString(PyExc_ValueError, "Parameter dispatchWorkers can't be combined with loop or eventQueueSize.");
+      return nullptr;
+    }
+  }
+
   auto self = (HomegearObject *)type->tp_alloc(type, 0);
   if (!self) return nullptr;
+  self->moduleState = (HomegearModuleState *)PyType_GetModuleState(type);
+  self->converter = self->moduleState->converter;
+  self->interpreter = PyThreadState_GetInterpreter(PyThreadState_Get());
+  self->threadStates = new HomegearThreadStates(self->interpreter);
   //Py_INCREF(self); //valgrind does not complain if we don't do this and the dealloc is only called after setting the object to "None".
 
   self->socketPath = new std::string(socketPath);
   if (self->socketPath->front() == '"' && self->socketPath->back() == '"') *self->socketPath = self->socketPath->substr(1, self->socketPath->length() - 2);
 
+  //The references to the callbacks are only added once all parameters are valid, so no error path has to release them.
+  Py_XINCREF(tempEventCallback);         /* Add a reference to new callback */
   self->eventCallback = tempEventCallback;
+  self->batchEvents = batchEvents;
+  self->connectTimeout = connectTimeout;
+  Py_XINCREF(connectCallback);
+  self->connectCallback = connectCallback;
+  Py_XINCREF(writeErrorCallback);
+  self->writeErrorCallback = writeErrorCallback;
+  self->binaryAsMemoryView = binaryAsMemoryView;
+  self->lazyContainers = lazyContainers;
+  if (eventQueueSize > 0) self->eventQueue = new EventQueue(eventQueueSize, eventQueuePolicy);
+  self->pullEvents = pullEvents;
+  if (dispatchWorkers > 0) {
+    //The jobs capture self without a reference: the pool is stopped by the dealloc before the object is freed and jobs are skipped once the dealloc
+    //started, so no job runs for an object which is being destroyed.
+    self->dispatchPool = new DispatchPool(dispatchWorkers, kDispatchQueueSize, eventQueuePolicy, [self](std::vector<DispatchPool::Job> &jobs) {
+      PyThreadState *threadState = Homegear_ensureGil(self);
+      for (auto &job : jobs) {
+        if (self->deallocating) break;
+        job();
+      }
+      Homegear_releaseGil(threadState);
+    });
+  }
+  Py_XINCREF(tempNodeInputCallback);         /* Add a reference to new callback */
   self->nodeInputCallback = tempNodeInputCallback;
+  if (self->nodeInputCallback) {
+    self->nodeInfoMutex = new std::mutex();
+    self->nodeInfo = new Ipc::PVariable();
+  }
   if (nodeId) self->nodeId = new std::string(nodeId);
   else self->nodeId = new std::string();
+  if (!self->nodeId->empty()) self->nodeIdVariable = new Ipc::PVariable(std::make_shared<Ipc::Variable>(*self->nodeId));
 
+  self->metrics = new Metrics();
   self->ipcClient = new IpcClient(*self->socketPath);
+  self->ipcClient->setMetrics(self->metrics);
+  self->ipcClientPool = new IpcClientPool(self->ipcClient, *self->socketPath, connections);
+  if (valueCacheSize > 0) {
+    self->valueCache = new ValueCache(valueCacheSize);
+    self->ipcClient->setValueCache(self->valueCache);
+  }
+  if (writeBehindInterval > 0) {
+    auto interval = std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::duration<double>(writeBehindInterval));
+    self->writeBuffer = new WriteBuffer(self->ipcClientPool, interval, [self](std::vector<WriteBuffer::Write> &writes, const Ipc::PVariable &result) {
+      Homegear_handleWriteResults(self, writes, result);
+    }, self->metrics->getMethodStats("system.multicall"));
+  }
+  if (offlineQueueSize > 0) {
+    self->offlineQueue = new OfflineQueue(self->ipcClientPool, offlineQueueSize, offlineQueueFile ? offlineQueueFile : "", [self](std::vector<WriteBuffer::Write> &writes, const Ipc::PVariable &result) {
+      Homegear_handleWriteResults(self, writes, result);
+    }, self->metrics->getMethodStats("system.multicall"));
+  }
+  self->subscriptions = PyDict_New();
+  self->methodCache = PyDict_New();
+  if (!self->subscriptions || !self->methodCache) {
+    Py_DECREF(self);
+    return nullptr;
+  }
+
+  if (loop) {
+    Py_INCREF(loop);
+    self->loop = loop;
+    self->asyncWorkers = asyncWorkers;
+    self->pendingFutures = PyDict_New();
+    self->futureMutex = new std::mutex();
+    self->futureResultKinds = new std::unordered_map<uint64_t, HomegearFutureResult>();
+    self->connectFutureIds = new std::vector<uint64_t>();
+    self->eventStreams = PyList_New(0);
+  }
 
   self->onConnectConditionVariable = new std::condition_variable;
   self->onConnectWaitMutex = new std::mutex;
@@ -411,7 +2344,37 @@ static PyObject *Homegear_new(PyTypeObject *type, PyObject *arg, PyObject *kw) {
 }
 
 static int Homegear_init(HomegearObject *self, PyObject *arg) {
-  if (self->eventCallback) {
+  if (self->loop && !self->asyncBridge) {
+    if (!self->pendingFutures || !self->eventStreams) return -1;
+    self->asyncBridge = new AsyncBridge(self->ipcClientPool, self->asyncWorkers);
+
+    PyObject *weakSelf = PyWeakref_NewRef((PyObject *)self, nullptr);
+    if (!weakSelf) return -1;
+    PyObject *readableCallback = PyCFunction_New(&HomegearAsyncReadableMethod, weakSelf);
+    Py_DECREF(weakSelf);
+    if (!readableCallback) return -1;
+    PyObject *result = PyObject_CallMethod(self->loop, "add_reader", "iO", self->asyncBridge->fileDescriptor(), readableCallback);
+    Py_DECREF(readableCallback);
+    if (!result) return -1;
+    Py_DECREF(result);
+  }
+
+  if (self->pullEvents && self->eventQueue->enableFileDescriptor() == -1) {
+    PyErr_SetFromErrno(PyExc_OSError);
+    return -1;
+  }
+  if (self->eventQueue && !self->asyncBridge && !self->pullEvents && !self->eventDispatcherThread) self->eventDispatcherThread = new std::thread(&Homegear_dispatchEvents, self);
+
+  if (self->asyncBridge || self->eventQueue || self->dispatchPool || (self->eventCallback && self->batchEvents)) {
+    self->ipcClient->setBroadcastEventBatch(std::function<void(std::string &, uint64_t, int32_t, Ipc::PArray &, Ipc::PArray &)>(std::bind(&Homegear_handleEvent,
+                                                                                                                                    self,
+                                                                                                                                    0,
+                                                                                                                                    std::placeholders::_1,
+                                                                                                                                    std::placeholders::_2,
+                                                                                                                                    std::placeholders::_3,
+                                                                                                                                    std::placeholders::_4,
+                                                                                                                                    std::placeholders::_5)));
+  } else if (self->eventCallback) {
     self->ipcClient->setBroadcastEvent(std::function<void(std::string &, uint64_t, int32_t, std::string &, Ipc::PVariable)>(std::bind(&Homegear_broadcastEvent,
                                                                                                                                       self,
                                                                                                                                       std::placeholders::_1,
@@ -421,6 +2384,15 @@ static int Homegear_init(HomegearObject *self, PyObject *arg) {
                                                                                                                                       std::placeholders::_5)));
   }
 
+  self->ipcClient->setSubscriptionEvent(std::function<void(uint64_t, std::string &, uint64_t, int32_t, Ipc::PArray &, Ipc::PArray &)>(std::bind(&Homegear_handleEvent,
+                                                                                                                                          self,
+                                                                                                                                          std::placeholders::_1,
+                                                                                                                                          std::placeholders::_2,
+                                                                                                                                          std::placeholders::_3,
+                                                                                                                                          std::placeholders::_4,
+                                                                                                                                          std::placeholders::_5,
+                                                                                                                                          std::placeholders::_6)));
+
   if (self->nodeInputCallback) {
     self->ipcClient->setNodeInput(std::function<void(const Ipc::PVariable &nodeInfo, uint32_t inputIndex, const Ipc::PVariable message)>(std::bind(&Homegear_nodeInput,
                                                                                                                                                    self,
@@ -431,17 +2403,143 @@ static int Homegear_init(HomegearObject *self, PyObject *arg) {
 
   self->ipcClient->setOnConnect(std::function<void(void)>(std::bind(&Homegear_onConnect, self)));
   self->ipcClient->start();
-  std::unique_lock<std::mutex> waitLock(*self->onConnectWaitMutex);
-  int64_t startTime = Ipc::HelperFunctions::getTime();
-  while (!self->onConnectConditionVariable->wait_for(waitLock, std::chrono::milliseconds(2000), [&] {
-    if (Ipc::HelperFunctions::getTime() - startTime > 2000) return true;
-    else return self->ipcClient->connected();
-  }));
+  self->ipcClientPool->start();
+  if (self->connectTimeout > 0) {
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::duration<double>(self->connectTimeout));
+    Py_BEGIN_ALLOW_THREADS
+    Homegear_waitForConnection(self, deadline);
+    Py_END_ALLOW_THREADS
+  }
 
   return 0;
 }
 
+/**
+ * Detaches the cached methods, which only hold a borrowed reference to the object. Methods still referenced elsewhere return None afterwards.
+ */
+static void Homegear_clearMethodCache(HomegearObject *self) {
+  if (!self->methodCache) return;
+  PyObject *key = nullptr;
+  PyObject *value = nullptr;
+  Py_ssize_t pos = 0;
+  while (PyDict_Next(self->methodCache, &pos, &key, &value)) {
+    auto methodObject = (HomegearRpcMethod *)value;
+    if (methodObject->borrowedObject) HomegearRpcMethod_clear(methodObject);
+  }
+  PyDict_Clear(self->methodCache);
+}
+
+/**
+ * Removes the reader from the event loop, cancels the pending futures and releases all Python objects of the asyncio mode. The asyncio mode methods
+ * raise an exception afterwards. The GIL must be held.
+ */
+static void Homegear_clearAsyncMode(HomegearObject *self) {
+  if (self->asyncBridge && self->loop) {
+    PyObject *result = PyObject_CallMethod(self->loop, "remove_reader", "i", self->asyncBridge->fileDescriptor());
+    if (result) Py_DECREF(result);
+    else PyErr_Clear();
+  }
+
+  if (self->pendingFutures) {
+    PyObject *key = nullptr;
+    PyObject *future = nullptr;
+    Py_ssize_t pos = 0;
+    while (PyDict_Next(self->pendingFutures, &pos, &key, &future)) {
+      PyObject *result = PyObject_CallMethod(future, "cancel", nullptr);
+      if (result) Py_DECREF(result);
+      else PyErr_Clear();
+    }
+    Py_CLEAR(self->pendingFutures);
+  }
+  if (self->futureResultKinds) {
+    std::lock_guard<std::mutex> futureGuard(*self->futureMutex);
+    self->futureResultKinds->clear();
+  }
+  self->hasEventStreams = false;
+  Py_CLEAR(self->eventStreams);
+  Py_CLEAR(self->loop);
+}
+
 static void Homegear_dealloc(HomegearObject *self) {
+  PyObject_GC_UnTrack(self);
+  if (self->weakReferences) PyObject_ClearWeakRefs((PyObject *)self);
+  self->deallocating = true;
+
+  Homegear_clearAsyncMode(self);
+
+  if (self->ipcClient) {
+    //Stopping the client joins its threads, which might be waiting for the GIL in one of the callbacks.
+    Py_BEGIN_ALLOW_THREADS
+    if (self->writeBuffer) {
+      delete self->writeBuffer; //Sends the remaining writes.
+      self->writeBuffer = nullptr;
+    }
+    //A stopped queue no longer blocks the IPC thread, which otherwise might wait for space forever in pull mode.
+    if (self->eventQueue) self->eventQueue->stop();
+    //The IPC threads use the event queue, the dispatch pool, the offline queue and the value cache, so they are joined before anything else is freed.
+    //This also makes calls still executed by the async bridge's worker threads return.
+    if (self->ipcClientPool) self->ipcClientPool->stop();
+    else self->ipcClient->stop();
+    if (self->offlineQueue) {
+      delete self->offlineQueue; //Saves the remaining writes.
+      self->offlineQueue = nullptr;
+    }
+    if (self->eventDispatcherThread) {
+      if (self->eventDispatcherThread->joinable()) self->eventDispatcherThread->join();
+      delete self->eventDispatcherThread;
+      self->eventDispatcherThread = nullptr;
+    }
+    if (self->dispatchPool) {
+      delete self->dispatchPool;
+      self->dispatchPool = nullptr;
+    }
+    if (self->asyncBridge) {
+      delete self->asyncBridge;
+      self->asyncBridge = nullptr;
+    }
+    delete self->ipcClientPool;
+    self->ipcClientPool = nullptr;
+    delete self->ipcClient;
+    Py_END_ALLOW_THREADS
+    self->ipcClient = nullptr;
+  }
+
+  if (self->eventQueue) {
+    delete self->eventQueue;
+    self->eventQueue = nullptr;
+  }
+
+  if (self->threadStates) {
+    delete self->threadStates; //All threads calling into Python were joined above.
+    self->threadStates = nullptr;
+  }
+
+  if (self->valueCache) {
+    delete self->valueCache;
+    self->valueCache = nullptr;
+  }
+
+  if (self->metrics) {
+    delete self->metrics;
+    self->metrics = nullptr;
+  }
+
+  if (self->futureResultKinds) {
+    delete self->futureResultKinds;
+    self->futureResultKinds = nullptr;
+  }
+  if (self->futureMutex) {
+    delete self->futureMutex;
+    self->futureMutex = nullptr;
+  }
+  if (self->connectFutureIds) {
+    delete self->connectFutureIds;
+    self->connectFutureIds = nullptr;
+  }
+  Py_CLEAR(self->subscriptions);
+  Homegear_clearMethodCache(self);
+  Py_CLEAR(self->methodCache);
+
   if (self->eventCallback) {
     Py_XDECREF(self->eventCallback);
     self->eventCallback = nullptr;
@@ -452,9 +2550,23 @@ static void Homegear_dealloc(HomegearObject *self) {
     self->nodeInputCallback = nullptr;
   }
 
-  if (self->ipcClient) {
-    delete self->ipcClient;
-    self->ipcClient = nullptr;
+  Py_CLEAR(self->connectCallback);
+  Py_CLEAR(self->writeErrorCallback);
+  Py_CLEAR(self->nodeInfoObject);
+
+  if (self->nodeInfo) {
+    delete self->nodeInfo;
+    self->nodeInfo = nullptr;
+  }
+
+  if (self->nodeInfoMutex) {
+    delete self->nodeInfoMutex;
+    self->nodeInfoMutex = nullptr;
+  }
+
+  if (self->nodeIdVariable) {
+    delete self->nodeIdVariable;
+    self->nodeIdVariable = nullptr;
   }
 
   if (self->nodeId) {
@@ -477,7 +2589,44 @@ static void Homegear_dealloc(HomegearObject *self) {
     self->onConnectWaitMutex = nullptr;
   }
 
-  Py_TYPE(self)->tp_free(self);
+  PyTypeObject *type = Py_TYPE(self);
+  type->tp_free(self);
+  Py_DECREF(type);
+}
+
+/**
+ * The callbacks are visited but not cleared, because the IPC threads access them without holding the GIL. Clearing the caches and the objects of the
+ * asyncio mode breaks all cycles created by this extension, e. g. through a task awaiting one of the pending futures.
+ */
+static int Homegear_traverse(HomegearObject *self, visitproc visit, void *arg) {
+  Py_VISIT(Py_TYPE(self));
+  Py_VISIT(self->eventCallback);
+  Py_VISIT(self->nodeInputCallback);
+  Py_VISIT(self->connectCallback);
+  Py_VISIT(self->writeErrorCallback);
+  Py_VISIT(self->loop);
+  Py_VISIT(self->pendingFutures);
+  Py_VISIT(self->eventStreams);
+  Py_VISIT(self->subscriptions);
+  Py_VISIT(self->methodCache);
+  Py_VISIT(self->nodeInfoObject);
+  return 0;
+}
+
+static int Homegear_clear(HomegearObject *self) {
+  Homegear_clearAsyncMode(self);
+  Homegear_clearMethodCache(self);
+  if (self->subscriptions) PyDict_Clear(self->subscriptions);
+  if (self->nodeInfoMutex) {
+    PyObject *nodeInfoObject = nullptr;
+    {
+      std::lock_guard<std::mutex> nodeInfoGuard(*self->nodeInfoMutex);
+      nodeInfoObject = self->nodeInfoObject;
+      self->nodeInfoObject = nullptr;
+    }
+    Py_XDECREF(nodeInfoObject);
+  }
+  return 0;
 }
 
 static PyObject *Homegear_call(PyObject *object, PyObject *attrName) {
@@ -488,43 +2637,126 @@ static PyObject *Homegear_call(PyObject *object, PyObject *attrName) {
     return nullptr;
   }
 
+  //Fast path: method objects are cached by name, so repeated calls of the same method only cost a dict lookup.
+  PyObject *cachedMethodObject = homegearObject->methodCache ? Homegear_getDictItem(homegearObject->methodCache, attrName) : nullptr;
+  if (cachedMethodObject) return cachedMethodObject;
+
+  //Methods implemented by the extension itself take precedence over RPC methods.
+  int isTypeAttribute = PyDict_Contains(Py_TYPE(object)->tp_dict, attrName);
+  if (isTypeAttribute == -1) return nullptr;
+  if (isTypeAttribute == 1) return PyObject_GenericGetAttr(object, attrName);
+
   Py_ssize_t methodNameSize = 0;
   const char *methodName = PyUnicode_AsUTF8AndSize(attrName, &methodNameSize);
   if (!methodName) return nullptr;
 
-  auto homegearMethodObject = (HomegearRpcMethod *)HomegearRpcMethodType.tp_alloc(&HomegearRpcMethodType, 0);
+  auto rpcMethodType = (PyTypeObject *)homegearObject->moduleState->rpcMethodType;
+  auto homegearMethodObject = (HomegearRpcMethod *)rpcMethodType->tp_alloc(rpcMethodType, 0);
   if (!homegearMethodObject) return nullptr;
   //Py_INCREF(homegearMethodObject); //valgrind does not complain if we don't do this and the dealloc is only called after setting the object to "None".
 
+  homegearMethodObject->vectorcall = HomegearRpcMethod_vectorcall;
   homegearMethodObject->methodName = new std::string(methodName, methodNameSize);
-  homegearMethodObject->ipcClient = homegearObject->ipcClient;
-  homegearMethodObject->nodeId = homegearObject->nodeId;
+  if (*homegearMethodObject->methodName == "connected") homegearMethodObject->kind = HomegearRpcMethodKind::kConnected;
+  else if (kNodeMethods.find(*homegearMethodObject->methodName) != kNodeMethods.end()) homegearMethodObject->kind = HomegearRpcMethodKind::kNode;
+  else if (ValueCache::isReadMethod(*homegearMethodObject->methodName)) homegearMethodObject->kind = HomegearRpcMethodKind::kCachedRead;
+  else if (ValueCache::isWriteMethod(*homegearMethodObject->methodName)) homegearMethodObject->kind = HomegearRpcMethodKind::kCacheWrite;
+  else homegearMethodObject->kind = HomegearRpcMethodKind::kRpc;
+  homegearMethodObject->homegearObject = object;
+
+  if (homegearObject->methodCache && PyDict_GET_SIZE(homegearObject->methodCache) < kMaxCachedMethods) {
+    PyObject *internedName = attrName;
+    Py_INCREF(internedName);
+    PyUnicode_InternInPlace(&internedName);
+    if (PyDict_SetItem(homegearObject->methodCache, internedName, (PyObject *)homegearMethodObject) == 0) homegearMethodObject->borrowedObject = true;
+    else PyErr_Clear();
+    Py_DECREF(internedName);
+  }
+  if (!homegearMethodObject->borrowedObject) Py_INCREF(object);
 
   return (PyObject *)homegearMethodObject;
 }
 
-static struct PyModuleDef HomegearModule = {
-    PyModuleDef_HEAD_INIT,
-    "homegear",   /* name of module */
-    nullptr, /* module documentation, may be NULL */
-    -1,       /* size of per-interpreter state of the module, or -1 if the module keeps state in global variables. */
-    nullptr
-};
+static int Homegear_moduleExec(PyObject *module) {
+  auto state = (HomegearModuleState *)PyModule_GetState(module);
 
-PyMODINIT_FUNC PyInit_homegear(void) {
-  PyEval_InitThreads(); //Bugfix - Not needed in Python 3.6+, no-op when called for a second time. Must be called from the main thread.
+  state->converter = new PythonVariableConverter();
+  if (state->converter->init(module) < 0) return -1;
+
+  state->homegearType = PyType_FromModuleAndSpec(module, &HomegearObjectSpec, nullptr);
+  if (!state->homegearType) return -1;
+  state->rpcMethodType = PyType_FromModuleAndSpec(module, &HomegearRpcMethodSpec, nullptr);
+  if (!state->rpcMethodType) return -1;
+  state->eventStreamType = PyType_FromModuleAndSpec(module, &HomegearEventStreamSpec, nullptr);
+  if (!state->eventStreamType) return -1;
+#if PY_VERSION_HEX < 0x030A0000
+  ((PyTypeObject *)state->eventStreamType)->tp_new = nullptr; //Py_TPFLAGS_DISALLOW_INSTANTIATION is not available
+#endif
+  state->resultIteratorType = PyType_FromModuleAndSpec(module, &HomegearResultIteratorSpec, nullptr);
+  if (!state->resultIteratorType) return -1;
+#if PY_VERSION_HEX < 0x030A0000
+  ((PyTypeObject *)state->resultIteratorType)->tp_new = nullptr;
+#endif
+
+  if (PyModule_AddType(module, (PyTypeObject *)state->homegearType) < 0) return -1;
+  if (PyModule_AddType(module, (PyTypeObject *)state->rpcMethodType) < 0) return -1;
+
+  return 0;
+}
 
-  if (PyType_Ready(&HomegearObjectType) < 0 || PyType_Ready(&HomegearRpcMethodType) < 0) return nullptr;
+static int Homegear_moduleTraverse(PyObject *module, visitproc visit, void *arg) {
+  auto state = (HomegearModuleState *)PyModule_GetState(module);
+  Py_VISIT(state->homegearType);
+  Py_VISIT(state->rpcMethodType);
+  Py_VISIT(state->eventStreamType);
+  Py_VISIT(state->resultIteratorType);
+  return 0;
+}
 
-  PyObject *m = PyModule_Create(&HomegearModule);
+/**
+ * Only clears the types. Objects of the module might still use the converter until they are destroyed, so it is deleted in Homegear_moduleFree().
+ */
+static int Homegear_moduleClear(PyObject *module) {
+  auto state = (HomegearModuleState *)PyModule_GetState(module);
+  Py_CLEAR(state->homegearType);
+  Py_CLEAR(state->rpcMethodType);
+  Py_CLEAR(state->eventStreamType);
+  Py_CLEAR(state->resultIteratorType);
+  return 0;
+}
 
-  if (!m) return nullptr;
+static void Homegear_moduleFree(void *module) {
+  Homegear_moduleClear((PyObject *)module);
+  auto state = (HomegearModuleState *)PyModule_GetState((PyObject *)module);
+  if (state->converter) {
+    delete state->converter;
+    state->converter = nullptr;
+  }
+}
 
-  Py_INCREF(&HomegearObjectType);
-  PyModule_AddObject(m, "Homegear", (PyObject *)&HomegearObjectType);
+static PyModuleDef_Slot HomegearModuleSlots[] = {
+    {Py_mod_exec, (void *)Homegear_moduleExec},
+#ifdef Py_mod_multiple_interpreters
+    {Py_mod_multiple_interpreters, Py_MOD_PER_INTERPRETER_GIL_SUPPORTED},
+#endif
+#ifdef Py_mod_gil
+    {Py_mod_gil, Py_MOD_GIL_NOT_USED},
+#endif
+    {0, nullptr}
+};
 
-  Py_INCREF(&HomegearRpcMethodType);
-  PyModule_AddObject(m, "HomegearRpcMethod", (PyObject *)&HomegearRpcMethodType);
+static struct PyModuleDef HomegearModule = {
+    PyModuleDef_HEAD_INIT,
+    "homegear",   /* name of module */
+    nullptr, /* module documentation, may be NULL */
+    sizeof(HomegearModuleState), /* size of per-interpreter state of the module */
+    nullptr,
+    HomegearModuleSlots,
+    Homegear_moduleTraverse,
+    Homegear_moduleClear,
+    Homegear_moduleFree
+};
 
-  return m;
+PyMODINIT_FUNC PyInit_homegear(void) {
+  return PyModuleDef_Init(&HomegearModule);
 }
@@ -2,8 +2,8 @@ import setuptools
 import sys
 from distutils.core import Extension
 
-if sys.version_info < (3,0):
-    sys.exit('Sorry, Python < 3.0 is not supported')
+if sys.version_info < (3,9):
+    sys.exit('Sorry, Python < 3.9 is not supported')
 
 with open("README.md", "r") as fh:
     long_description = fh.read()
@@ -22,11 +22,12 @@ setuptools.setup(
 	url="https://github.com/Homegear/python3-homegear",
 	keywords = ['homegear', 'smart home'],
 	ext_modules=[
-		Extension("homegear", ["homegear.cpp", "IpcClient.cpp", "PythonVariableConverter.cpp"],
+		Extension("homegear", ["homegear.cpp", "AsyncBridge.cpp", "EventFilter.cpp", "DispatchPool.cpp", "EventQueue.cpp", "IpcClient.cpp", "IpcClientPool.cpp", "Metrics.cpp", "OfflineQueue.cpp", "PythonVariableConverter.cpp", "ValueCache.cpp", "WriteBuffer.cpp"],
 		extra_compile_args=['-std=c++17'],
 		extra_link_args=['-lhomegear-ipc', '-latomic'])
 	],
 	include_package_data=True,
+	python_requires=">=3.9",
 	classifiers=(
 		"Programming Language :: C++",
 		"License :: OSI Approved :: GNU Lesser General Public License v3 (LGPLv3)",
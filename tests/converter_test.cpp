@@ -0,0 +1,192 @@
+/* Copyright 2013-2019 Homegear GmbH
+ *
+ * Homegear is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * Homegear is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with Homegear.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ *
+ * In addition, as a special exception, the copyright holders give
+ * permission to link the code of portions of this program with the
+ * OpenSSL library under certain conditions as described in each
+ * individual source file, and distribute linked combinations
+ * including the two.
+ * You must obey the GNU Lesser General Public License in all respects
+ * for all of the code used other than OpenSSL.  If you modify
+ * file(s) with this exception, you may extend this exception to your
+ * version of the file(s), but you are not obligated to do so.  If you
+ * do not wish to do so, delete this exception statement from your
+ * version.  If you delete this exception statement from all source
+ * files in the program, then also delete it here.
+*/
+
+/*
+ * Checks PythonVariableConverter against the type mapping in README.md: every Python value is converted to the expected Homegear variable and, where
+ * the mapping is lossless, back to an equal Python value. Returns 0 when all checks pass.
+ *
+ * Usage: converter_test
+ */
+
+#include "../PythonVariableConverter.h"
+
+#include <cmath>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+namespace {
+
+Ipc::PVariable array(std::vector<Ipc::PVariable> elements) {
+  auto variable = std::make_shared<Ipc::Variable>(Ipc::VariableType::tArray);
+  for (auto &element : elements) {
+    variable->arrayValue->push_back(element);
+  }
+  return variable;
+}
+
+Ipc::PVariable structValue(std::vector<std::pair<std::string, Ipc::PVariable>> elements) {
+  auto variable = std::make_shared<Ipc::Variable>(Ipc::VariableType::tStruct);
+  for (auto &element : elements) {
+    variable->structValue->emplace(element.first, element.second);
+  }
+  return variable;
+}
+
+Ipc::PVariable integer(int64_t value) { return std::make_shared<Ipc::Variable>(value); }
+Ipc::PVariable floatValue(double value) { return std::make_shared<Ipc::Variable>(value); }
+Ipc::PVariable boolean(bool value) { return std::make_shared<Ipc::Variable>(value); }
+Ipc::PVariable string(const std::string &value) { return std::make_shared<Ipc::Variable>(value); }
+Ipc::PVariable binary(const std::string &value) { return std::make_shared<Ipc::Variable>(std::vector<char>(value.begin(), value.end())); }
+Ipc::PVariable voidValue() { return std::make_shared<Ipc::Variable>(Ipc::VariableType::tVoid); }
+
+struct ConversionCase {
+  std::string expression;
+  Ipc::PVariable expected;
+  std::string roundTrip; //Python value expected after converting back, empty when equal to expression, "-" when the conversion is lossy
+};
+
+const std::vector<ConversionCase> kConversionCases{
+    {"None", voidValue(), ""},
+    {"True", boolean(true), ""},
+    {"False", boolean(false), ""},
+    {"0", integer(0), ""},
+    {"-1", integer(-1), ""},
+    {"2**31 - 1", integer(2147483647ll), ""},
+    {"2**31", integer(2147483648ll), ""},
+    {"-2**31", integer(-2147483648ll), ""},
+    {"-2**31 - 1", integer(-2147483649ll), ""},
+    {"2**63 - 1", integer(INT64_MAX), ""},
+    {"-2**63", integer(INT64_MIN), ""},
+    {"2**63", floatValue(9223372036854775808.0), "float(2**63)"},
+    {"-2**64", floatValue(-18446744073709551616.0), "float(-2**64)"},
+    {"10**400", voidValue(), "-"},
+    {"1.5", floatValue(1.5), ""},
+    {"-0.0", floatValue(-0.0), ""},
+    {"1e308", floatValue(1e308), ""},
+    {"''", string(""), ""},
+    {"'temperature'", string("temperature"), ""},
+    {"'\\u00e4\\u20ac\\U0001f600'", string("\xc3\xa4\xe2\x82\xac\xf0\x9f\x98\x80"), ""},
+    {"'\\ud800'", string(""), "-"},
+    {"b''", binary(""), ""},
+    {"b'\\x00\\xff'", binary(std::string("\x00\xff", 2)), ""},
+    {"bytearray(b'ab')", binary("ab"), "b'ab'"},
+    {"memoryview(b'abc')", binary("abc"), "b'abc'"},
+    {"memoryview(b'abcdef')[::2]", binary("ace"), "b'ace'"},
+    {"array.array('B', [1, 2, 3])", binary("\x01\x02\x03"), "b'\\x01\\x02\\x03'"},
+    {"[]", array({}), ""},
+    {"()", array({}), "[]"},
+    {"[1, 'a', [2.5, (None, True)]]", array({integer(1), string("a"), array({floatValue(2.5), array({voidValue(), boolean(true)})})}), "[1, 'a', [2.5, [None, True]]]"},
+    {"{}", structValue({}), ""},
+    {"{'a': 1, 'b': {'c': [None, b'x']}}", structValue({{"a", integer(1)}, {"b", structValue({{"c", array({voidValue(), binary("x")})}})}}), ""},
+    {"{1: 'x', True: 'y'}", structValue({{"1", string("y")}}), "{'1': 'y'}"},
+    {"object()", std::make_shared<Ipc::Variable>(), "-"},
+};
+
+int failures = 0;
+
+void fail(const std::string &expression, const std::string &message) {
+  printf("FAIL %s: %s\n", expression.c_str(), message.c_str());
+  failures++;
+}
+
+PyObject *evaluate(const std::string &expression, PyObject *globals) {
+  PyObject *value = PyRun_String(expression.c_str(), Py_eval_input, globals, globals);
+  if (!value) PyErr_Print();
+  return value;
+}
+
+}
+
+int main() {
+  Py_Initialize();
+  auto converter = new PythonVariableConverter();
+  if (converter->init() < 0) {
+    PyErr_Print();
+    return 1;
+  }
+
+  PyObject *globals = PyDict_New();
+  PyDict_SetItemString(globals, "__builtins__", PyEval_GetBuiltins());
+  PyObject *arrayModule = PyImport_ImportModule("array");
+  if (!arrayModule) {
+    PyErr_Print();
+    return 1;
+  }
+  PyDict_SetItemString(globals, "array", arrayModule);
+  Py_DECREF(arrayModule);
+
+  Metrics metrics;
+  for (auto &conversionCase : kConversionCases) {
+    PyObject *value = evaluate(conversionCase.expression, globals);
+    if (!value) {
+      fail(conversionCase.expression, "Could not evaluate expression.");
+      continue;
+    }
+
+    auto variable = PythonVariableConverter::getVariable(value, &metrics.bytesToHomegear);
+    if (PyErr_Occurred()) {
+      PyErr_Print();
+      fail(conversionCase.expression, "getVariable() left an exception set.");
+    }
+    if (!variable || !(*variable == *conversionCase.expected)) fail(conversionCase.expression, "getVariable() returned an unexpected variable.");
+
+    //getArray() must convert each element exactly like getVariable().
+    auto parameters = PythonVariableConverter::getArray(&value, 1, &metrics.bytesToHomegear, string("first"));
+    if (parameters->size() != 2 || !(*parameters->at(0) == *string("first")) || !(*parameters->at(1) == *conversionCase.expected)) {
+      fail(conversionCase.expression, "getArray() differs from getVariable().");
+    }
+
+    if (conversionCase.roundTrip != "-") {
+      PyObject *expected = conversionCase.roundTrip.empty() ? value : evaluate(conversionCase.roundTrip, globals);
+      Py_XINCREF(expected);
+      for (bool lazyContainers : {false, true}) {
+        PyObject *result = converter->getPythonVariable(variable, metrics.bytesToPython, false, lazyContainers);
+        int equal = result && expected ? PyObject_RichCompareBool(result, expected, Py_EQ) : -1;
+        if (equal == -1) PyErr_Print();
+        if (equal != 1) fail(conversionCase.expression, lazyContainers ? "Lazy round trip returned a different value." : "Round trip returned a different value.");
+        //-0.0 == 0.0, so the sign is compared separately.
+        if (result && PyFloat_Check(result) && expected && PyFloat_Check(expected) && std::signbit(PyFloat_AS_DOUBLE(result)) != std::signbit(PyFloat_AS_DOUBLE(expected))) {
+          fail(conversionCase.expression, "Round trip changed the sign.");
+        }
+        Py_XDECREF(result);
+      }
+      Py_XDECREF(expected);
+    }
+    Py_DECREF(value);
+  }
+
+  if (metrics.bytesToHomegear.get() == 0 || metrics.bytesToPython->get() == 0) fail("metrics", "Converted bytes were not counted.");
+
+  printf("%zu cases, %d failures\n", kConversionCases.size(), failures);
+  Py_DECREF(globals);
+  delete converter;
+  return failures == 0 ? 0 : 1;
+}
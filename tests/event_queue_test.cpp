@@ -0,0 +1,137 @@
+/* Copyright 2013-2019 Homegear GmbH
+ *
+ * Homegear is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * Homegear is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with Homegear.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ *
+ * In addition, as a special exception, the copyright holders give
+ * permission to link the code of portions of this program with the
+ * OpenSSL library under certain conditions as described in each
+ * individual source file, and distribute linked combinations
+ * including the two.
+ * You must obey the GNU Lesser General Public License in all respects
+ * for all of the code used other than OpenSSL.  If you modify
+ * file(s) with this exception, you may extend this exception to your
+ * version of the file(s), but you are not obligated to do so.  If you
+ * do not wish to do so, delete this exception statement from your
+ * version.  If you delete this exception statement from all source
+ * files in the program, then also delete it here.
+*/
+
+/*
+ * Checks EventQueue with more variables per broadcastEvent than the queue can hold. Returns 0 when all checks pass.
+ *
+ * Usage: event_queue_test
+ */
+
+#include "../EventQueue.h"
+
+#include <chrono>
+#include <cstdio>
+#include <future>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace {
+
+int failures = 0;
+
+void fail(const std::string &name, const std::string &message) {
+  printf("FAIL %s: %s\n", name.c_str(), message.c_str());
+  failures++;
+}
+
+void createEvent(size_t variableCount, Ipc::PArray &variableNames, Ipc::PArray &values) {
+  variableNames = std::make_shared<Ipc::Array>();
+  values = std::make_shared<Ipc::Array>();
+  for (size_t i = 0; i < variableCount; i++) {
+    variableNames->push_back(std::make_shared<Ipc::Variable>("VARIABLE_" + std::to_string(i)));
+    values->push_back(std::make_shared<Ipc::Variable>((int64_t)i));
+  }
+}
+
+/*
+ * Pushes one event with variableCount variables into a queue with the given capacity and pops on a second thread the way Homegear's event thread does.
+ * Fails when push() or pop() do not return within a few seconds.
+ */
+void checkLargeEvent(const std::string &name, size_t capacity, size_t variableCount, EventQueue::OverflowPolicy policy, size_t expectedCount, bool fileDescriptor) {
+  EventQueue queue(capacity, policy);
+  if (fileDescriptor && queue.enableFileDescriptor() == -1) {
+    fail(name, "Could not create the file descriptor.");
+    return;
+  }
+
+  Ipc::PArray variableNames;
+  Ipc::PArray values;
+  createEvent(variableCount, variableNames, values);
+
+  std::vector<EventQueue::Entry> entries;
+  std::promise<void> consumerStarted;
+  std::thread consumer([&] {
+    consumerStarted.set_value();
+    while (entries.size() < expectedCount) {
+      if (!queue.pop(entries, expectedCount, true)) return;
+    }
+  });
+  consumerStarted.get_future().wait();
+
+  auto pushResult = std::async(std::launch::async, [&] { return queue.push(1, "device", 5, 1, variableNames, values); });
+  if (pushResult.wait_for(std::chrono::seconds(5)) != std::future_status::ready) {
+    fail(name, "push() did not return.");
+  } else if (!pushResult.get()) {
+    fail(name, "push() returned false.");
+  }
+
+  for (int i = 0; i < 500 && entries.size() < expectedCount; i++) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+  }
+  //Stopping wakes up push() and pop(), so the threads can be joined in every case.
+  queue.stop();
+  consumer.join();
+  if (pushResult.valid()) pushResult.wait();
+
+  if (entries.size() != expectedCount) {
+    fail(name, "Popped " + std::to_string(entries.size()) + " of " + std::to_string(expectedCount) + " entries.");
+    return;
+  }
+  if (policy == EventQueue::OverflowPolicy::kBlock) {
+    for (size_t i = 0; i < entries.size(); i++) {
+      if (entries[i].variableName != "VARIABLE_" + std::to_string(i) || entries[i].value->integerValue64 != (int64_t)i) {
+        fail(name, "Entry " + std::to_string(i) + " is out of order.");
+        return;
+      }
+    }
+  }
+}
+
+}
+
+int main() {
+  checkLargeEvent("block", 4, 100, EventQueue::OverflowPolicy::kBlock, 100, false);
+  checkLargeEvent("block with file descriptor", 4, 100, EventQueue::OverflowPolicy::kBlock, 100, true);
+  checkLargeEvent("block with capacity 1", 1, 10, EventQueue::OverflowPolicy::kBlock, 10, false);
+
+  //Without blocking, push() returns immediately and the consumer gets whatever is left.
+  EventQueue queue(4, EventQueue::OverflowPolicy::kDropOldest);
+  Ipc::PArray variableNames;
+  Ipc::PArray values;
+  createEvent(10, variableNames, values);
+  if (!queue.push(1, "device", 5, 1, variableNames, values)) fail("drop oldest", "push() returned false.");
+  std::vector<EventQueue::Entry> entries;
+  queue.pop(entries, 10, false);
+  if (entries.size() != 4 || entries.front().variableName != "VARIABLE_6" || queue.droppedCount() != 6) fail("drop oldest", "Unexpected entries.");
+
+  printf("%d failures\n", failures);
+  return failures == 0 ? 0 : 1;
+}